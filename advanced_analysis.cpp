@@ -1,5 +1,7 @@
 #include "advanced_analysis.h"
 #include "diffphc_core.h"
+#include "diffphc_kernels.h"
+#include "diffphc_stability.h"
 #include <algorithm>
 #include <numeric>
 #include <cmath>
@@ -289,6 +291,33 @@ std::map<std::string, double> AdvancedAnalysis::analyzeFrequencyBands(const std:
 }
 
 // Anomaly Detection Implementation
+namespace {
+
+// Значения за пределами [q1 - k·IQR, q3 + k·IQR]
+std::vector<int> outliersOutside(const std::vector<int64_t>& values, double q1, double q3, double multiplier) {
+    std::vector<int> outliers;
+    const double iqr = q3 - q1;
+    const double lower_bound = q1 - multiplier * iqr;
+    const double upper_bound = q3 + multiplier * iqr;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (values[i] < lower_bound || values[i] > upper_bound) {
+            outliers.push_back(i);
+        }
+    }
+    return outliers;
+}
+
+std::vector<double> modifiedZScores(const std::vector<int64_t>& values, double median, double mad) {
+    std::vector<double> z_scores(values.size());
+    double mad_scaled = mad * 1.4826; // Scale factor for normal distribution
+    for (size_t i = 0; i < values.size(); ++i) {
+        z_scores[i] = (mad_scaled > 1e-10) ? (values[i] - median) / mad_scaled : 0.0;
+    }
+    return z_scores;
+}
+
+} // namespace
+
 AnomalyDetection AdvancedAnalysis::detectAnomalies(const std::vector<int64_t>& values, double threshold_multiplier) {
     AnomalyDetection result;
     
@@ -296,27 +325,33 @@ AnomalyDetection AdvancedAnalysis::detectAnomalies(const std::vector<int64_t>& v
         return result; // Empty result for insufficient data
     }
     
-    // Convert to double for better precision
-    std::vector<double> double_values = convertToDouble(values);
+    // Квартили и медиана - одним выбором, MAD - вторым, в общих буферах
+    PHCQuantileSelector selector;
+    const double q[3] = {0.25, 0.5, 0.75};
+    double quartiles[3];
+    selector.select(values.data(), values.size(), q, 3, quartiles);
+    const double median = quartiles[1];
     
     // Use IQR method for anomaly detection
-    result.outlier_indices = detectOutliersIQR(values, threshold_multiplier);
+    if (values.size() >= 4) {
+        result.outlier_indices = outliersOutside(values, quartiles[0], quartiles[2], threshold_multiplier);
+    }
     result.total_anomalies = result.outlier_indices.size();
     result.anomaly_rate = (double)result.total_anomalies / values.size() * 100.0;
     
     // Calculate outlier scores using modified Z-score
-    std::vector<double> z_scores = calculateModifiedZScore(values);
+    std::vector<double> z_scores = modifiedZScores(values, median, selector.medianAbsoluteDeviation(values, median));
     result.outlier_scores.resize(values.size());
     result.threshold = threshold_multiplier;
     
     for (size_t i = 0; i < values.size(); ++i) {
         result.outlier_scores[i] = std::abs(z_scores[i]);
-        if (std::find(result.outlier_indices.begin(), result.outlier_indices.end(), i) != result.outlier_indices.end()) {
-            if (z_scores[i] > threshold_multiplier) {
-                result.anomaly_types.push_back("high_outlier");
-            } else {
-                result.anomaly_types.push_back("low_outlier");
-            }
+    }
+    for (int i : result.outlier_indices) {
+        if (z_scores[i] > threshold_multiplier) {
+            result.anomaly_types.push_back("high_outlier");
+        } else {
+            result.anomaly_types.push_back("low_outlier");
         }
     }
     
@@ -324,78 +359,131 @@ AnomalyDetection AdvancedAnalysis::detectAnomalies(const std::vector<int64_t>& v
 }
 
 std::vector<int> AdvancedAnalysis::detectOutliersIQR(const std::vector<int64_t>& values, double multiplier) {
-    std::vector<int> outliers;
-    
     if (values.size() < 4) {
-        return outliers;
-    }
-    
-    std::vector<int64_t> sorted_values = values;
-    std::sort(sorted_values.begin(), sorted_values.end());
-    
-    size_t n = sorted_values.size();
-    size_t q1_index = n / 4;
-    size_t q3_index = 3 * n / 4;
-    
-    int64_t q1 = sorted_values[q1_index];
-    int64_t q3 = sorted_values[q3_index];
-    int64_t iqr = q3 - q1;
-    
-    int64_t lower_bound = q1 - multiplier * iqr;
-    int64_t upper_bound = q3 + multiplier * iqr;
-    
-    for (size_t i = 0; i < values.size(); ++i) {
-        if (values[i] < lower_bound || values[i] > upper_bound) {
-            outliers.push_back(i);
-        }
+        return std::vector<int>();
     }
     
-    return outliers;
+    const double q[2] = {0.25, 0.75};
+    double quartiles[2];
+    PHCQuantileSelector().select(values.data(), values.size(), q, 2, quartiles);
+    return outliersOutside(values, quartiles[0], quartiles[1], multiplier);
 }
 
 std::vector<double> AdvancedAnalysis::calculateModifiedZScore(const std::vector<int64_t>& values) {
-    std::vector<double> z_scores(values.size());
-    
     if (values.size() < 3) {
-        return z_scores;
-    }
-    
-    // Calculate median
-    std::vector<int64_t> sorted_values = values;
-    std::sort(sorted_values.begin(), sorted_values.end());
-    double median = (sorted_values.size() % 2 == 0) ? 
-        (sorted_values[sorted_values.size()/2 - 1] + sorted_values[sorted_values.size()/2]) / 2.0 :
-        sorted_values[sorted_values.size()/2];
-    
-    // Calculate median absolute deviation
-    std::vector<double> deviations(values.size());
-    for (size_t i = 0; i < values.size(); ++i) {
-        deviations[i] = std::abs(values[i] - median);
+        return std::vector<double>(values.size());
     }
-    std::sort(deviations.begin(), deviations.end());
-    double mad = (deviations.size() % 2 == 0) ?
-        (deviations[deviations.size()/2 - 1] + deviations[deviations.size()/2]) / 2.0 :
-        deviations[deviations.size()/2];
     
-    // Calculate modified Z-scores
-    double mad_scaled = mad * 1.4826; // Scale factor for normal distribution
-    for (size_t i = 0; i < values.size(); ++i) {
-        z_scores[i] = (mad_scaled > 1e-10) ? (values[i] - median) / mad_scaled : 0.0;
+    PHCQuantileSelector selector;
+    double median = selector.median(values);
+    return modifiedZScores(values, median, selector.medianAbsoluteDeviation(values, median));
+}
+
+namespace {
+
+std::string pairName(const PHCResult& result, size_t i, size_t j) {
+    if (i >= result.devices.size() || j >= result.devices.size()) {
+        return std::string();
     }
-    
-    return z_scores;
+    return "ptp" + std::to_string(result.devices[i]) + "-ptp" + std::to_string(result.devices[j]);
+}
+
+// Шаг фазовых данных (нс) - интервал сетки измерения, как в CLI; медиана
+// интервалов меток времени только для результатов без интервала
+double phaseStep(const PHCResult& result) {
+    if (result.interval > 0) {
+        return double(result.interval);
+    }
+    const auto& series = result.series;
+    std::vector<int64_t> intervals(series.size() - 1);
+    for (size_t row = 1; row < series.size(); ++row) {
+        intervals[row - 1] = series.timestamp(row) - series.timestamp(row - 1);
+    }
+    return PHCQuantileSelector().median(intervals);
+}
+
+} // namespace
+
+// Stability Analysis Implementation
+StabilityAnalysis AdvancedAnalysis::analyzeStability(const PHCResult& result, size_t i, size_t j) {
+    StabilityAnalysis analysis;
+    analysis.tau0 = 0.0;
+    const auto& series = result.series;
+    if (series.size() < 3 || i >= series.numDevices() || j >= series.numDevices() || i == j) {
+        return analysis;
+    }
+    analysis.pair = pairName(result, i, j);
+    
+    const double tau0 = phaseStep(result);
+    if (tau0 <= 0) {
+        return analysis;
+    }
+    analysis.tau0 = tau0 / 1e9;
+    
+    PHCPhaseSegments segments;
+    segments.build(series, i, j, tau0);
+    analysis.gaps = segments.gaps;
+    std::vector<PHCStabilityPoint> points;
+    PHCStability::compute(segments, tau0, points);
+    for (const auto& point : points) {
+        analysis.taus.push_back(point.tau);
+        analysis.adev.push_back(point.adev);
+        analysis.mdev.push_back(point.mdev);
+        analysis.tdev.push_back(point.tdev);
+    }
+    return analysis;
+}
+
+// MTIE Analysis Implementation
+bool AdvancedAnalysis::analyzeMTIE(const PHCResult& result, const std::string& mask, MtieAnalysis& analysis,
+                                   std::string& error, size_t i, size_t j) {
+    analysis = MtieAnalysis();
+    analysis.tau0 = 0.0;
+    analysis.mask = mask;
+    analysis.passed = true;
+    PHCMtieMask limits;
+    if (!mask.empty() && !limits.parse(mask, error)) {
+        return false;
+    }
+    const auto& series = result.series;
+    if (series.size() < 2 || i >= series.numDevices() || j >= series.numDevices() || i == j) {
+        return true;
+    }
+    analysis.pair = pairName(result, i, j);
+    
+    const double tau0 = phaseStep(result);
+    if (tau0 <= 0) {
+        return true;
+    }
+    analysis.tau0 = tau0 / 1e9;
+    
+    PHCPhaseSegments segments;
+    segments.build(series, i, j, tau0);
+    analysis.gaps = segments.gaps;
+    std::vector<PHCMtiePoint> points;
+    PHCMtie::compute(segments, tau0, points);
+    analysis.passed = limits.apply(points);
+    for (const auto& point : points) {
+        analysis.taus.push_back(point.tau);
+        analysis.mtie.push_back(point.mtie);
+        analysis.limits.push_back(point.limit);
+        analysis.checked = analysis.checked || point.limit > 0;
+    }
+    // Маска без единого проверенного интервала не считается пройденной
+    if (!limits.empty() && !analysis.checked) {
+        analysis.passed = false;
+    }
+    return true;
 }
 
 // Utility Functions
 std::vector<double> AdvancedAnalysis::convertToDouble(const std::vector<int64_t>& values) {
     std::vector<double> result(values.size());
-    for (size_t i = 0; i < values.size(); ++i) {
-        int64_t val = values[i];
+    PHCKernels::toDouble(values.data(), values.size(), result.data());
+    for (double& value : result) {
         // Ограничиваем значения разумными пределами для предотвращения переполнения
-        if (std::abs(val) > 1e12) {
-            result[i] = 0.0; // Заменяем неразумные значения на 0
-        } else {
-            result[i] = static_cast<double>(val);
+        if (std::abs(value) > 1e12) {
+            value = 0.0; // Заменяем неразумные значения на 0
         }
     }
     return result;
@@ -411,18 +499,13 @@ std::vector<int64_t> AdvancedAnalysis::generateTimestamps(int64_t start_time, in
 
 double AdvancedAnalysis::calculateMean(const std::vector<double>& values) {
     if (values.empty()) return 0.0;
-    return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    return PHCKernels::sum(values.data(), values.size()) / values.size();
 }
 
 double AdvancedAnalysis::calculateStdDev(const std::vector<double>& values, double mean) {
     if (values.size() < 2) return 0.0;
     
-    double sum_squared_diff = 0.0;
-    for (double value : values) {
-        double diff = value - mean;
-        sum_squared_diff += diff * diff;
-    }
-    
+    double sum_squared_diff = PHCKernels::sumSquares(values.data(), values.size(), mean);
     return std::sqrt(sum_squared_diff / (values.size() - 1));
 }
 
@@ -455,7 +538,7 @@ AdvancedStatistics AdvancedAnalysis::performComprehensiveAnalysis(const PHCResul
     AdvancedStatistics stats;
     auto start_time = std::chrono::high_resolution_clock::now();
     
-    if (!result.success || result.differences.empty()) {
+    if (!result.success || result.series.empty()) {
         // Возвращаем пустую статистику с разумными значениями
         stats.trend.trend_type = "no_data";
         stats.trend.slope = 0.0;
@@ -509,9 +592,7 @@ AdvancedStatistics AdvancedAnalysis::performComprehensiveAnalysis(const PHCResul
     std::vector<int64_t> relative_differences;
     if (time_series.size() > 1) {
         // Используем медиану как базовое значение для более стабильного анализа
-        std::vector<int64_t> sorted_times = time_series;
-        std::sort(sorted_times.begin(), sorted_times.end());
-        int64_t base_time = sorted_times[sorted_times.size() / 2]; // медиана
+        int64_t base_time = int64_t(PHCQuantileSelector().median(time_series)); // медиана
         
         for (int64_t value : time_series) {
             int64_t diff = value - base_time;
@@ -530,6 +611,11 @@ AdvancedStatistics AdvancedAnalysis::performComprehensiveAnalysis(const PHCResul
     // Perform anomaly detection on relative differences (fast)
     stats.anomalies = detectAnomalies(relative_differences);
     
+    // Стабильность - по измеренной истории первой пары устройств
+    stats.stability = analyzeStability(result);
+    std::string mtie_error;
+    analyzeMTIE(result, "", stats.mtie, mtie_error);
+    
     // Set metadata
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
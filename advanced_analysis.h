@@ -59,6 +59,30 @@ struct TimeSeriesPrediction {
     std::string model_type;                     // Тип модели
 };
 
+// Stability Analysis Structures
+struct StabilityAnalysis {
+    std::string pair;                   // Пара устройств, например "ptp1-ptp0"
+    double tau0;                        // Шаг фазовых данных (с)
+    std::vector<double> taus;           // Интервалы усреднения τ (с), октавы τ0
+    std::vector<double> adev;           // Девиация Аллана (перекрывающаяся)
+    std::vector<double> mdev;           // Модифицированная девиация Аллана
+    std::vector<double> tdev;           // Временная девиация (нс)
+    uint64_t gaps = 0;                  // Разрывы фазы; оценки по отрезкам без разрывов
+};
+
+// MTIE Analysis Structures
+struct MtieAnalysis {
+    std::string pair;                   // Пара устройств, например "ptp1-ptp0"
+    double tau0;                        // Шаг фазовых данных (с)
+    std::vector<double> taus;           // Интервалы наблюдения τ (с), октавы τ0
+    std::vector<int64_t> mtie;          // MTIE (нс)
+    std::vector<double> limits;         // Пределы маски (нс), 0 - τ вне маски
+    std::string mask;                   // Спецификация маски TAU:NS,... (пустая - без проверки)
+    bool passed;                        // Все интервалы в пределах маски
+    bool checked = false;               // Хотя бы один интервал попал в маску
+    uint64_t gaps = 0;                  // Разрывы фазы; окна только внутри отрезков
+};
+
 // Advanced Statistics Container
 struct AdvancedStatistics {
     TrendAnalysis trend;
@@ -66,6 +90,8 @@ struct AdvancedStatistics {
     CorrelationAnalysis correlation;
     AnomalyDetection anomalies;
     TimeSeriesPrediction prediction;
+    StabilityAnalysis stability;
+    MtieAnalysis mtie;
     
     // Metadata
     std::string analysis_timestamp;
@@ -99,6 +125,14 @@ public:
     static std::vector<int> detectOutliersIQR(const std::vector<int64_t>& values, double multiplier = 1.5);
     static std::vector<int> detectOutliersZScore(const std::vector<int64_t>& values, double threshold = 3.0);
     
+    // Stability Analysis: ADEV/MDEV/TDEV разности устройств i и j по
+    // хранимым итерациям; шаг τ0 - медиана интервалов меток времени
+    static StabilityAnalysis analyzeStability(const PHCResult& result, size_t i = 1, size_t j = 0);
+    // MTIE пары i, j по хранимым итерациям (интервалы считаются параллельно)
+    // с проверкой маски "TAU:NS,..."; false и error - при ошибке в маске
+    static bool analyzeMTIE(const PHCResult& result, const std::string& mask, MtieAnalysis& analysis,
+                            std::string& error, size_t i = 1, size_t j = 0);
+    
     // Time Series Prediction
     static TimeSeriesPrediction predictTimeSeries(const std::vector<int64_t>& values, int horizon = 10);
     static std::vector<double> simpleMovingAverage(const std::vector<int64_t>& values, int window_size = 5);
@@ -1,5 +1,12 @@
 #include "diffphc_core.h"
+#include "diffphc_clock_source.h"
+#include "diffphc_compressed.h"
+#include "diffphc_recording.h"
+#include "diffphc_rollup.h"
+#include "diffphc_stability.h"
+#include "diffphc_kernels.h"
 #include <getopt.h>
+#include <signal.h>
 #include <iomanip>
 #include <iostream>
 
@@ -11,7 +18,28 @@ private:
     bool json_output = false;
     bool show_statistics = true;
     bool statistics_only = false;
+    bool csv_format = false;
+    bool benchmark = false;
+    bool benchmark_kernels = false;     // Сравнить векторные ядра статистики
+    bool compress = false;              // Сжимать вытесненные из истории итерации
+    size_t archived_rows = 0;           // Итераций в сжатом архиве сводки
+    int baseline_count = 0;             // Итераций прогона без realtime для сравнения (0 - без прогона)
+    double baseline_rejection = -1.0;   // Доля отброшенных отсчетов до включения realtime, %
     std::string output_file;
+    std::string record_file;            // Двоичная запись сеанса (.phcrec)
+    std::string replay_file;            // Сохраненный сеанс для повторного анализа
+    int rollup_resolution = 0;          // Разрешение отчета агрегации (с, 0 - без отчета)
+    const PHCRollup* rollup_report = nullptr;
+    bool windows = false;               // Статистика скользящих окон 1 с / 1 мин / 1 ч
+    const PHCSlidingStats* window_report = nullptr;
+    bool stability = false;             // Отчет ADEV/MDEV/TDEV
+    std::vector<std::vector<PHCStabilityPoint>> stability_curves;   // По парам i > j
+    bool mtie = false;                  // Отчет MTIE
+    PHCMtieMask mtie_mask;              // Маска допуска MTIE (пустая - без проверки)
+    bool mtie_failed = false;           // Хотя бы одна пара превысила маску или маска не проверена
+    bool mtie_checked = false;          // Хотя бы один интервал попал в маску
+    uint64_t phase_gaps = 0;            // Разрывы фазовых данных (ошибки чтения, пропуски сетки)
+    std::vector<std::vector<PHCMtiePoint>> mtie_curves;             // По парам i > j
 
 public:
     void printHelp() {
@@ -33,9 +61,49 @@ public:
             << "  -j, --json          Вывод результатов в формате JSON\n"
             << "  -o, --output FILE   Записать вывод в файл\n"
             << "\nРасширенные опции:\n"
-            << "  --continuous        Запуск непрерывно (то же что -c 0)\n"
+            << "  --continuous        Запуск непрерывно (то же что -c 0): итерации выводятся\n"
+            << "                      по мере поступления, Ctrl+C завершает измерение\n"
             << "  --csv               Вывод в формате CSV\n"
             << "  --precision NUM     Установить точность для временных различий (по умолчанию: 0)\n"
+            << "  --method [DEV:]NAME Способ чтения PHC: auto, precise, extended, basic, direct\n"
+            << "                      (по умолчанию: auto; DEV: задает способ для одного устройства)\n"
+            << "  --benchmark         Сравнить стоимость способов чтения PHC и выйти\n"
+            << "  --benchmark-kernels Сравнить скалярные и векторные (AVX2, AVX-512) ядра\n"
+            << "                      статистики на -c значениях и выйти\n"
+            << "  --realtime          Режим реального времени: SCHED_FIFO, mlockall, cpu_dma_latency=0\n"
+            << "  --rt-priority NUM   Приоритет SCHED_FIFO для --realtime (по умолчанию: 80)\n"
+            << "  --cpu NUM           Закрепить измерительный поток на CPU (для --realtime)\n"
+            << "  --rt-baseline NUM   Перед --realtime выполнить NUM итераций без него с теми\n"
+            << "                      же -l и -s и сравнить долю отброшенных отсчетов\n"
+            << "  --adaptive          Подбирать число отсчетов для каждого устройства\n"
+            << "  --target-uncertainty NS  Целевая неопределенность чтения для --adaptive\n"
+            << "                      (по умолчанию: 100 нс)\n"
+            << "  --simulate [DEV:]SPEC  Использовать модель PHC вместо /dev/ptpN (root не нужен).\n"
+            << "                      SPEC: key=value через запятую: offset, drift, wander,\n"
+            << "                      step-interval, step, latency, jitter, outliers,\n"
+            << "                      outlier-latency, precise, seed (DEV: - для одного устройства)\n"
+            << "  --history NUM       Хранить в памяти не более NUM последних итераций\n"
+            << "                      (непрерывный режим по умолчанию: 65536)\n"
+            << "  --history-memory MB Ограничить память истории измерений мегабайтами\n"
+            << "  --record FILE       Записать сеанс в двоичный файл (mmap-формат .phcrec)\n"
+            << "  --replay FILE       Повторить анализ сохраненного сеанса (.phcrec, CSV или\n"
+            << "                      JSON вывод shiwadiffphc) без устройств и root\n"
+            << "  --rollup SEC        Отчет по интервалам: min/max/mean/σ пар по секундам,\n"
+            << "                      минутам или часам (самый грубый уровень не длиннее SEC)\n"
+            << "  --windows           Статистика пар за последние 1 с, 1 мин и 1 ч: в\n"
+            << "                      непрерывном режиме ежесекундно и в итоговой сводке\n"
+            << "  --stability         Девиации Аллана (ADEV, MDEV, TDEV) пар для октавных\n"
+            << "                      интервалов τ = 1, 2, 4... шагов -l\n"
+            << "  --mtie              MTIE пар (наибольший размах TIE в окне τ) для октавных\n"
+            << "                      интервалов τ = 1, 2, 4... шагов -l\n"
+            << "  --mtie-mask SPEC    Проверить MTIE по маске (включает --mtie): точки TAU:NS\n"
+            << "                      через запятую, предел между ними линейный; при\n"
+            << "                      превышении код возврата 4\n"
+            << "  --compress          Сжимать вытесненные из истории итерации: итоговая\n"
+            << "                      статистика непрерывного режима по всему измерению\n"
+            << "  --parallel          Читать устройства параллельно (отдельный поток на устройство)\n"
+            << "  --cpus LIST         CPU для потоков чтения, через запятую (например: 2,3,4);\n"
+            << "                      с --realtime у каждого устройства свой CPU\n"
             << "\nСтатистические опции:\n"
             << "  --stats             Показать статистический анализ (по умолчанию: включено)\n"
             << "  --no-stats          Отключить показ статистики\n"
@@ -74,13 +142,14 @@ public:
             if (phc_fd >= 0) {
                 ptp_clock_caps caps = {};
                 if (!ioctl(phc_fd, PTP_CLOCK_GETCAPS, &caps)) {
-                    struct ptp_sys_offset_extended sys_off_ext = {};
-                    sys_off_ext.n_samples = 1;
-                    bool supportOffsetExtended = !ioctl(phc_fd, PTP_SYS_OFFSET_EXTENDED, &sys_off_ext);
+                    bool supportOffsetPrecise = DiffPHCCore::supportsReadMethod(phc_fd, PHCReadMethod::Precise);
+                    bool supportOffsetExtended = DiffPHCCore::supportsReadMethod(phc_fd, PHCReadMethod::Extended);
                     std::cout << " (ext_ts: " << caps.n_ext_ts 
                               << ", pins: " << caps.n_pins
                               << ", pps: " << (caps.pps ? "yes" : "no")
-                              << ", offset_ext: " << (supportOffsetExtended ? "yes" : "no") << ")";
+                              << ", offset_precise: " << (supportOffsetPrecise ? "yes" : "no")
+                              << ", offset_ext: " << (supportOffsetExtended ? "yes" : "no")
+                              << ", method: " << DiffPHCCore::readMethodName(DiffPHCCore::probeReadMethod(phc_fd)) << ")";
                 }
                 close(phc_fd);
             }
@@ -88,7 +157,7 @@ public:
         }
     }
 
-    void outputResults(const PHCResult& result, bool csv_format = false) {
+    void outputResults(const PHCResult& result) {
         if (!result.success) {
             std::cerr << "Error: " << result.error << std::endl;
             return;
@@ -101,6 +170,14 @@ public:
 
         if (csv_format) {
             outputResultsCSV(result);
+            if (rollup_report) {
+                outputRollup(*rollup_report, result.devices);
+            }
+            if (window_report) {
+                outputWindows(*window_report, result.devices);
+            }
+            outputStability(result.devices);
+            outputMtie(result.devices);
             return;
         }
 
@@ -112,10 +189,537 @@ public:
                 outputStatistics(result);
             }
         }
+        if (rollup_report) {
+            outputRollup(*rollup_report, result.devices);
+        }
+        if (window_report) {
+            outputWindows(*window_report, result.devices);
+        }
+        outputStability(result.devices);
+        outputMtie(result.devices);
+    }
+
+    // Кривые стабильности по потоковым накопителям
+    void collectStability(const PHCStabilitySink& sink) {
+        stability_curves.clear();
+        phase_gaps = sink.gaps();
+        for (size_t i = 1; i < sink.numDevices(); ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                stability_curves.emplace_back();
+                sink.curve(i, j, stability_curves.back());
+            }
+        }
+    }
+
+    // Число разрывов фазы перед кривыми стабильности и MTIE
+    void outputPhaseGaps() {
+        if (phase_gaps == 0) {
+            return;
+        }
+        if (json_output) {
+            std::cout << "{\"phase_gaps\": " << phase_gaps << "}\n";
+        } else if (csv_format) {
+            std::cout << "\n# Разрывов фазы: " << phase_gaps << "\n";
+        } else {
+            std::cout << "\nРазрывов фазы: " << phase_gaps
+                      << " (ошибки чтения или пропущенные итерации), оценки по отрезкам без разрывов" << std::endl;
+        }
+    }
+
+    void outputStability(const std::vector<int>& devices) {
+        if (stability_curves.empty()) {
+            return;
+        }
+        outputPhaseGaps();
+        auto pairName = [&](size_t i, size_t j) {
+            return "ptp" + std::to_string(devices[i]) + "-ptp" + std::to_string(devices[j]);
+        };
+
+        if (json_output) {
+            size_t p = 0;
+            for (size_t i = 1; i < devices.size() && p < stability_curves.size(); ++i) {
+                for (size_t j = 0; j < i; ++j, ++p) {
+                    for (const auto& point : stability_curves[p]) {
+                        std::cout << "{\"stability\": {\"pair\": \"" << pairName(i, j) << "\""
+                                  << ", \"tau\": " << point.tau << ", \"adev\": " << point.adev
+                                  << ", \"mdev\": " << point.mdev << ", \"tdev\": " << point.tdev
+                                  << ", \"terms\": " << point.terms << "}}\n";
+                    }
+                }
+            }
+            return;
+        }
+
+        if (csv_format) {
+            std::cout << "\n# Стабильность\npair,tau,adev,mdev,tdev,terms\n";
+            size_t p = 0;
+            for (size_t i = 1; i < devices.size() && p < stability_curves.size(); ++i) {
+                for (size_t j = 0; j < i; ++j, ++p) {
+                    for (const auto& point : stability_curves[p]) {
+                        std::cout << pairName(i, j) << "," << point.tau << "," << point.adev
+                                  << "," << point.mdev << "," << point.tdev << "," << point.terms << "\n";
+                    }
+                }
+            }
+            return;
+        }
+
+        std::cout << "\n=== СТАБИЛЬНОСТЬ (ADEV / MDEV / TDEV) ===" << std::endl;
+        size_t p = 0;
+        for (size_t i = 1; i < devices.size() && p < stability_curves.size(); ++i) {
+            for (size_t j = 0; j < i; ++j, ++p) {
+                std::cout << "Пара " << pairName(i, j) << ":" << std::endl;
+                // setw считает байты, поэтому заголовок с кириллицей выровнен вручную
+                std::cout << "        τ, с        ADEV        MDEV    TDEV, нс  Слагаемых" << std::endl;
+                for (const auto& point : stability_curves[p]) {
+                    std::cout << std::right << std::setw(12) << std::setprecision(4) << std::defaultfloat << point.tau
+                              << std::setw(12) << std::scientific << std::setprecision(3) << point.adev
+                              << std::setw(12) << point.mdev
+                              << std::setw(12) << std::fixed << std::setprecision(1) << point.tdev
+                              << std::setw(11) << point.terms << std::endl;
+                }
+                std::cout << std::defaultfloat << std::endl;
+            }
+        }
+    }
+
+    void outputStabilityJSON(const std::vector<int>& devices) {
+        std::cout << "  \"stability\": {";
+        size_t p = 0;
+        bool first = true;
+        for (size_t i = 1; i < devices.size() && p < stability_curves.size(); ++i) {
+            for (size_t j = 0; j < i; ++j, ++p) {
+                std::cout << (first ? "\n" : ",\n") << "    \"ptp" << devices[i] << "-ptp" << devices[j] << "\": [";
+                first = false;
+                for (size_t k = 0; k < stability_curves[p].size(); ++k) {
+                    const auto& point = stability_curves[p][k];
+                    std::cout << (k ? ",\n" : "\n") << "      {\"tau\": " << point.tau
+                              << ", \"adev\": " << point.adev << ", \"mdev\": " << point.mdev
+                              << ", \"tdev\": " << point.tdev << ", \"terms\": " << point.terms << "}";
+                }
+                std::cout << "\n    ]";
+            }
+        }
+        std::cout << "\n  },\n";
+    }
+
+    // Кривые MTIE по потоковым накопителям, с проверкой маски
+    void collectMtie(const PHCMtieSink& sink) {
+        mtie_curves.clear();
+        phase_gaps = sink.gaps();
+        for (size_t i = 1; i < sink.numDevices(); ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                mtie_curves.emplace_back();
+                sink.curve(i, j, mtie_curves.back());
+            }
+        }
+        applyMtieMask();
+    }
+
+    // Маска, не покрывшая ни одного интервала кривой, считается не
+    // пройденной: иначе короткие отрезки между разрывами давали бы ложный успех
+    void applyMtieMask() {
+        mtie_failed = false;
+        mtie_checked = false;
+        for (auto& curve : mtie_curves) {
+            mtie_failed = !mtie_mask.apply(curve) || mtie_failed;
+            for (const auto& point : curve) {
+                mtie_checked = mtie_checked || point.limit > 0;
+            }
+        }
+        if (!mtie_mask.empty() && !mtie_checked) {
+            mtie_failed = true;
+        }
+    }
+
+    std::string mtieVerdict() const {
+        if (!mtie_checked) {
+            return "НЕ ПРОВЕРЕНА (нет интервалов τ в пределах маски)";
+        }
+        if (mtie_failed) {
+            return "НЕ ПРОЙДЕНА";
+        }
+        return phase_gaps ? "пройдена по отрезкам без разрывов" : "пройдена";
+    }
+
+    void outputMtie(const std::vector<int>& devices) {
+        if (mtie_curves.empty()) {
+            return;
+        }
+        if (stability_curves.empty()) {
+            outputPhaseGaps();
+        }
+        auto pairName = [&](size_t i, size_t j) {
+            return "ptp" + std::to_string(devices[i]) + "-ptp" + std::to_string(devices[j]);
+        };
+
+        if (json_output) {
+            size_t p = 0;
+            for (size_t i = 1; i < devices.size() && p < mtie_curves.size(); ++i) {
+                for (size_t j = 0; j < i; ++j, ++p) {
+                    for (const auto& point : mtie_curves[p]) {
+                        std::cout << "{\"mtie\": {\"pair\": \"" << pairName(i, j) << "\""
+                                  << ", \"tau\": " << point.tau << ", \"mtie\": " << point.mtie
+                                  << ", \"windows\": " << point.windows;
+                        if (!mtie_mask.empty()) {
+                            std::cout << ", \"limit\": " << point.limit
+                                      << ", \"pass\": " << (point.pass ? "true" : "false");
+                        }
+                        std::cout << "}}\n";
+                    }
+                }
+            }
+            return;
+        }
+
+        if (csv_format) {
+            std::cout << "\n# MTIE\npair,tau,mtie,windows,limit,pass\n";
+            size_t p = 0;
+            for (size_t i = 1; i < devices.size() && p < mtie_curves.size(); ++i) {
+                for (size_t j = 0; j < i; ++j, ++p) {
+                    for (const auto& point : mtie_curves[p]) {
+                        std::cout << pairName(i, j) << "," << point.tau << "," << point.mtie
+                                  << "," << point.windows << "," << point.limit
+                                  << "," << (point.pass ? 1 : 0) << "\n";
+                    }
+                }
+            }
+            return;
+        }
+
+        std::cout << "\n=== MTIE ===" << std::endl;
+        size_t p = 0;
+        for (size_t i = 1; i < devices.size() && p < mtie_curves.size(); ++i) {
+            for (size_t j = 0; j < i; ++j, ++p) {
+                std::cout << "Пара " << pairName(i, j) << ":" << std::endl;
+                // setw считает байты, поэтому заголовок с кириллицей выровнен вручную
+                std::cout << "        τ, с    MTIE, нс        Окон" << (mtie_mask.empty() ? "" : "  Предел, нс") << std::endl;
+                for (const auto& point : mtie_curves[p]) {
+                    std::cout << std::right << std::setw(12) << std::setprecision(4) << std::defaultfloat << point.tau
+                              << std::setw(12) << point.mtie << std::setw(12) << point.windows;
+                    if (!mtie_mask.empty()) {
+                        if (point.limit > 0) {
+                            std::cout << std::setw(12) << std::fixed << std::setprecision(1) << point.limit
+                                      << std::defaultfloat << (point.pass ? "" : "  ПРЕВЫШЕН");
+                        } else {
+                            std::cout << std::setw(12) << "-";
+                        }
+                    }
+                    std::cout << std::endl;
+                }
+                std::cout << std::endl;
+            }
+        }
+        if (!mtie_mask.empty()) {
+            std::cout << "Маска MTIE: " << mtieVerdict() << std::endl;
+        }
+    }
+
+    void outputMtieJSON(const std::vector<int>& devices) {
+        std::cout << "  \"mtie\": {";
+        size_t p = 0;
+        bool first = true;
+        for (size_t i = 1; i < devices.size() && p < mtie_curves.size(); ++i) {
+            for (size_t j = 0; j < i; ++j, ++p) {
+                std::cout << (first ? "\n" : ",\n") << "    \"ptp" << devices[i] << "-ptp" << devices[j] << "\": [";
+                first = false;
+                for (size_t k = 0; k < mtie_curves[p].size(); ++k) {
+                    const auto& point = mtie_curves[p][k];
+                    std::cout << (k ? ",\n" : "\n") << "      {\"tau\": " << point.tau
+                              << ", \"mtie\": " << point.mtie << ", \"windows\": " << point.windows;
+                    if (!mtie_mask.empty()) {
+                        std::cout << ", \"limit\": " << point.limit
+                                  << ", \"pass\": " << (point.pass ? "true" : "false");
+                    }
+                    std::cout << "}";
+                }
+                std::cout << "\n    ]";
+            }
+        }
+        std::cout << "\n  },\n";
+        if (!mtie_mask.empty()) {
+            std::cout << "  \"mtie_mask_passed\": " << (mtie_failed ? "false" : "true") << ",\n";
+            std::cout << "  \"mtie_mask_checked\": " << (mtie_checked ? "true" : "false") << ",\n";
+        }
+    }
+
+    static std::string formatTime(int64_t ns) {
+        time_t seconds = ns / 1000000000LL;
+        struct tm tm;
+        localtime_r(&seconds, &tm);
+        char buffer[32];
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+        return buffer;
+    }
+
+    // Отчет агрегации на уровне для --rollup: таблица, секция CSV или
+    // строки JSON Lines (непрерывный режим с --json)
+    void outputRollup(const PHCRollup& rollup, const std::vector<int>& devices) {
+        const auto level = rollup.levelFor(int64_t(rollup_resolution) * 1000000000LL);
+        const auto& tier = rollup.tier(level);
+        const int64_t width = tier.width / 1000000000LL;
+        std::vector<const PHCRollupBucket*> buckets;
+        rollup.query(level, INT64_MIN, INT64_MAX, buckets);
+        const size_t numDev = std::min(devices.size(), rollup.numDevices());
+
+        if (json_output) {
+            for (const auto* bucket : buckets) {
+                for (size_t i = 1; i < numDev; ++i) {
+                    for (size_t j = 0; j < i; ++j) {
+                        const auto& c = bucket->cells[PHCRollup::pairIndex(i, j)];
+                        std::cout << "{\"rollup\": {\"start\": " << bucket->start
+                                  << ", \"width_s\": " << width
+                                  << ", \"pair\": \"ptp" << devices[i] << "-ptp" << devices[j] << "\""
+                                  << ", \"count\": " << c.count << ", \"minimum\": " << c.minimum
+                                  << ", \"maximum\": " << c.maximum << ", \"mean\": " << c.mean
+                                  << ", \"stddev\": " << c.stddev() << "}}\n";
+                    }
+                }
+            }
+            return;
+        }
+
+        if (csv_format) {
+            std::cout << "\n# Агрегация по " << width << " с\n"
+                      << "start,pair,count,minimum,maximum,range,mean,stddev\n";
+            for (const auto* bucket : buckets) {
+                for (size_t i = 1; i < numDev; ++i) {
+                    for (size_t j = 0; j < i; ++j) {
+                        const auto& c = bucket->cells[PHCRollup::pairIndex(i, j)];
+                        std::cout << bucket->start << ",ptp" << devices[i] << "-ptp" << devices[j]
+                                  << "," << c.count << "," << c.minimum << "," << c.maximum
+                                  << "," << c.range() << "," << c.mean << "," << c.stddev() << "\n";
+                    }
+                }
+            }
+            return;
+        }
+
+        std::cout << "\n=== АГРЕГАЦИЯ ПО " << width << " С ===" << std::endl;
+        // setw считает байты, поэтому заголовок с кириллицей выровнен вручную
+        std::cout << "Начало               Пара          Итераций       Мин      Макс    Размах"
+                     "     Среднее         σ" << std::endl;
+        for (const auto* bucket : buckets) {
+            for (size_t i = 1; i < numDev; ++i) {
+                for (size_t j = 0; j < i; ++j) {
+                    const auto& c = bucket->cells[PHCRollup::pairIndex(i, j)];
+                    std::string pair = "ptp" + std::to_string(devices[i]) + "-ptp" + std::to_string(devices[j]);
+                    std::cout << std::left << std::setw(21) << formatTime(bucket->start)
+                              << std::setw(12) << pair << std::right
+                              << std::setw(10) << c.count << std::setw(10) << c.minimum
+                              << std::setw(10) << c.maximum << std::setw(10) << c.range()
+                              << std::setw(12) << std::fixed << std::setprecision(1) << c.mean
+                              << std::setw(10) << c.stddev() << std::endl;
+                }
+            }
+        }
+    }
+
+    static std::string formatWidth(int64_t width) {
+        const int64_t seconds = width / 1000000000LL;
+        if (seconds >= 3600 && seconds % 3600 == 0) {
+            return std::to_string(seconds / 3600) + " ч";
+        }
+        if (seconds >= 60 && seconds % 60 == 0) {
+            return std::to_string(seconds / 60) + " мин";
+        }
+        return std::to_string(seconds) + " с";
+    }
+
+    // Статистика скользящих окон на момент последней итерации: таблица,
+    // секция CSV или строки JSON Lines (непрерывный режим с --json)
+    void outputWindows(const PHCSlidingStats& stats, const std::vector<int>& devices) {
+        const size_t numDev = std::min(devices.size(), stats.numDevices());
+
+        if (json_output) {
+            for (size_t i = 1; i < numDev; ++i) {
+                for (size_t j = 0; j < i; ++j) {
+                    for (size_t w = 0; w < stats.windowCount(); ++w) {
+                        const auto c = stats.statistics(w, i, j);
+                        std::cout << "{\"windows\": {\"timestamp\": " << stats.lastTimestamp()
+                                  << ", \"width_s\": " << stats.width(w) / 1000000000LL
+                                  << ", \"pair\": \"ptp" << devices[i] << "-ptp" << devices[j] << "\""
+                                  << ", \"count\": " << c.count << ", \"minimum\": " << c.minimum
+                                  << ", \"maximum\": " << c.maximum << ", \"mean\": " << c.mean
+                                  << ", \"stddev\": " << c.stddev() << "}}\n";
+                    }
+                }
+            }
+            return;
+        }
+
+        if (csv_format) {
+            std::cout << "\n# Скользящие окна\npair,width_s,count,minimum,maximum,range,mean,stddev\n";
+            for (size_t i = 1; i < numDev; ++i) {
+                for (size_t j = 0; j < i; ++j) {
+                    for (size_t w = 0; w < stats.windowCount(); ++w) {
+                        const auto c = stats.statistics(w, i, j);
+                        std::cout << "ptp" << devices[i] << "-ptp" << devices[j]
+                                  << "," << stats.width(w) / 1000000000LL << "," << c.count
+                                  << "," << c.minimum << "," << c.maximum << "," << c.range()
+                                  << "," << c.mean << "," << c.stddev() << "\n";
+                    }
+                }
+            }
+            return;
+        }
+
+        std::cout << "\n=== СКОЛЬЗЯЩИЕ ОКНА ===" << std::endl;
+        // setw считает байты, поэтому заголовок с кириллицей выровнен вручную
+        std::cout << "Пара          Окно    Итераций       Мин      Макс    Размах     Среднее         σ" << std::endl;
+        for (size_t i = 1; i < numDev; ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                std::string pair = "ptp" + std::to_string(devices[i]) + "-ptp" + std::to_string(devices[j]);
+                for (size_t w = 0; w < stats.windowCount(); ++w) {
+                    const auto c = stats.statistics(w, i, j);
+                    const std::string width = formatWidth(stats.width(w));
+                    // Кириллица в подписи окна: дополнение до 8 видимых символов
+                    const size_t visible = std::count_if(width.begin(), width.end(),
+                                                         [](char ch) { return (ch & 0xC0) != 0x80; });
+                    std::cout << std::left << std::setw(12) << pair << "  " << width
+                              << std::string(visible < 8 ? 8 - visible : 0, ' ') << std::right
+                              << std::setw(10) << c.count << std::setw(10) << c.minimum
+                              << std::setw(10) << c.maximum << std::setw(10) << c.range()
+                              << std::setw(12) << std::fixed << std::setprecision(1) << c.mean
+                              << std::setw(10) << c.stddev() << std::defaultfloat << std::endl;
+                }
+            }
+        }
+    }
+
+    // Ежесекундная строка окон в непрерывном режиме
+    void outputWindowsLive(const PHCSlidingStats& stats, const std::vector<int>& devices) {
+        if (json_output) {
+            outputWindows(stats, devices);
+            return;
+        }
+        const size_t numDev = std::min(devices.size(), stats.numDevices());
+        for (size_t i = 1; i < numDev; ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                std::cout << "Окна ptp" << devices[i] << "-ptp" << devices[j] << ":";
+                for (size_t w = 0; w < stats.windowCount(); ++w) {
+                    const auto c = stats.statistics(w, i, j);
+                    std::cout << (w ? " |" : "") << " " << formatWidth(stats.width(w)) << " "
+                              << std::fixed << std::setprecision(1) << c.mean << " ± " << c.stddev()
+                              << std::defaultfloat << " [" << c.minimum << ", " << c.maximum << "]";
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
+
+    void outputWindowsJSON(const PHCSlidingStats& stats, const std::vector<int>& devices) {
+        const size_t numDev = std::min(devices.size(), stats.numDevices());
+        std::cout << "  \"windows\": {\n";
+        std::cout << "    \"timestamp\": " << stats.lastTimestamp() << ",\n";
+        std::cout << "    \"pairs\": {";
+        bool first = true;
+        for (size_t i = 1; i < numDev; ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                std::cout << (first ? "\n" : ",\n") << "      \"ptp" << devices[i] << "-ptp" << devices[j] << "\": [";
+                first = false;
+                for (size_t w = 0; w < stats.windowCount(); ++w) {
+                    const auto c = stats.statistics(w, i, j);
+                    std::cout << (w ? ", " : "") << "{\"width_s\": " << stats.width(w) / 1000000000LL
+                              << ", \"count\": " << c.count << ", \"minimum\": " << c.minimum
+                              << ", \"maximum\": " << c.maximum << ", \"mean\": " << c.mean
+                              << ", \"stddev\": " << c.stddev() << "}";
+                }
+                std::cout << "]";
+            }
+        }
+        std::cout << "\n    }\n  },\n";
+    }
+
+    void outputReadMethods(const PHCResult& result, const char* prefix) {
+        std::cout << prefix << "Способ чтения:";
+        for (size_t i = 0; i < result.methods.size() && i < result.devices.size(); ++i) {
+            std::cout << " ptp" << result.devices[i] << "="
+                      << DiffPHCCore::readMethodName(result.methods[i]);
+        }
+        std::cout << "\n";
+    }
+
+    void outputCount(const PHCResult& result) {
+        const auto& series = result.series;
+        const size_t stored = series.size() + archived_rows;
+        if (!result.running.empty()) {
+            // Вытесненные итерации учтены потоковой статистикой
+            std::cout << "Количество измерений: " << result.running.lateness.count;
+            if (stored < result.running.lateness.count) {
+                std::cout << " (медиана и процентили - оценка t-digest)";
+            }
+        } else {
+            std::cout << "Количество измерений: " << stored;
+            // Старые итерации вытеснены из кольца истории
+            if (!series.empty() && series.limit() && series.sequence(series.size() - 1) >= stored) {
+                std::cout << " (последние из " << series.sequence(series.size() - 1) + 1 << ")";
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    void outputScheduling(const PHCResult& result) {
+        if (result.series.empty()) {
+            return;
+        }
+        const auto& sched = result.scheduling;
+        std::cout << "Опоздание планировщика: среднее " << std::fixed << std::setprecision(1)
+                  << sched.mean << " нс, p99 " << sched.p99 << " нс, макс " << sched.maximum << " нс, σ "
+                  << std::fixed << std::setprecision(1) << sched.stddev << " нс, пропущено дедлайнов: "
+                  << result.missedDeadlines << std::endl;
+    }
+
+    static double rejectionRate(const PHCResult& result) {
+        return result.samplesRead ? 100.0 * result.samplesRejected / result.samplesRead : 0.0;
+    }
+
+    void outputRejection(const PHCResult& result) {
+        if (!result.samplesRead) {
+            return;
+        }
+        std::cout << "Отброшено отсчетов: " << result.samplesRejected << " из " << result.samplesRead
+                  << " (" << std::fixed << std::setprecision(2) << rejectionRate(result) << "%)";
+        if (baseline_rejection >= 0) {
+            std::cout << ", без realtime: " << std::fixed << std::setprecision(2)
+                      << baseline_rejection << "%";
+        }
+        std::cout << std::endl;
+    }
+
+    void outputDeviceSamples(const PHCResult& result) {
+        if (!config.adaptiveSamples || result.deviceSamples.empty()) {
+            return;
+        }
+        std::cout << "Отсчетов на чтение:";
+        for (size_t i = 0; i < result.deviceSamples.size() && i < result.devices.size(); ++i) {
+            std::cout << " ptp" << result.devices[i] << "=" << result.deviceSamples[i];
+        }
+        std::cout << std::endl;
+    }
+
+    void outputReadStats(const PHCResult& result) {
+        for (size_t i = 0; i < result.readStats.size() && i < result.devices.size(); ++i) {
+            const auto& rs = result.readStats[i];
+            std::cout << "Чтение ptp" << result.devices[i] << ": " << rs.reads << " вызовов, ошибок "
+                      << rs.errors << ", длительность ср. " << std::fixed << std::setprecision(1)
+                      << rs.meanCallNs() << " нс / макс " << rs.callMaxNs << " нс, задержка ср. "
+                      << std::fixed << std::setprecision(1) << rs.meanDelay() << " нс / мин "
+                      << rs.minDelay << " нс" << std::endl;
+        }
     }
 
     void outputResultsTable(const PHCResult& result) {
-        const auto& devices = result.devices;
+        if (verbose && !result.methods.empty()) {
+            outputReadMethods(result, "");
+        }
+
+        // Matrix output for latest measurement
+        outputMatrix(result.devices, result.series.empty() ? PHCPairView()
+                                                           : result.pairs(result.series.size() - 1));
+    }
+
+    void outputMatrix(const std::vector<int>& devices, const PHCPairView& pairs) {
         const int numDev = devices.size();
 
         // Header
@@ -125,14 +729,11 @@ public:
         }
         std::cout << "\n";
 
-        // Matrix output for latest measurement
-        if (!result.differences.empty()) {
-            const auto& latest = result.differences.back();
-            int idx = 0;
+        if (!pairs.empty()) {
             for (int i = 0; i < numDev; ++i) {
                 std::cout << "ptp" << devices[i] << "\t";
                 for (int j = 0; j <= i; ++j) {
-                    int64_t diff = latest[idx++];
+                    int64_t diff = pairs(i, j);
                     if (i == j) {
                         std::cout << "0\t";  // Same device = 0 difference
                     } else {
@@ -156,7 +757,14 @@ public:
         const int numDev = devices.size();
         
         std::cout << "\n=== СТАТИСТИЧЕСКИЙ АНАЛИЗ ===" << std::endl;
-        std::cout << "Количество измерений: " << result.differences.size() << std::endl;
+        outputCount(result);
+        if (!result.methods.empty()) {
+            outputReadMethods(result, "");
+        }
+        outputScheduling(result);
+        outputRejection(result);
+        outputDeviceSamples(result);
+        outputReadStats(result);
         std::cout << std::endl;
         
         for (int i = 0; i < numDev; ++i) {
@@ -216,6 +824,14 @@ public:
                               << stats.stddev << " нс" << std::endl;
                 }
                 
+                // Процентили
+                const bool micro = std::max(std::abs(stats.p1), std::abs(stats.p999)) >= 1000;
+                const double unit = micro ? 1000.0 : 1.0;
+                std::cout << "  Процентили (" << (micro ? "μс" : "нс") << "):   " << std::fixed << std::setprecision(1)
+                          << "p1 " << stats.p1 / unit << ", p5 " << stats.p5 / unit
+                          << ", p95 " << stats.p95 / unit << ", p99 " << stats.p99 / unit
+                          << ", p99.9 " << stats.p999 / unit << std::endl;
+                
                 std::cout << "  Измерений:         " << stats.count << std::endl;
                 std::cout << std::endl;
             }
@@ -227,7 +843,14 @@ public:
         const int numDev = devices.size();
         
         std::cout << "=== СТАТИСТИЧЕСКИЙ АНАЛИЗ ВРЕМЕННЫХ РАЗЛИЧИЙ ===" << std::endl;
-        std::cout << "Количество измерений: " << result.differences.size() << std::endl;
+        outputCount(result);
+        if (!result.methods.empty()) {
+            outputReadMethods(result, "");
+        }
+        outputScheduling(result);
+        outputRejection(result);
+        outputDeviceSamples(result);
+        outputReadStats(result);
         std::cout << std::endl;
         
         // Заголовок таблицы
@@ -238,8 +861,10 @@ public:
                   << std::setw(12) << "Максимум"
                   << std::setw(12) << "Размах"
                   << std::setw(12) << "Станд.откл"
+                  << std::setw(12) << "P99"
+                  << std::setw(12) << "P99.9"
                   << std::setw(8) << "Счетчик" << std::endl;
-        std::cout << std::string(90, '-') << std::endl;
+        std::cout << std::string(114, '-') << std::endl;
         
         for (int i = 0; i < numDev; ++i) {
             for (int j = 0; j <= i; ++j) {
@@ -254,6 +879,8 @@ public:
                           << std::setw(12) << stats.maximum
                           << std::setw(12) << stats.range
                           << std::setw(12) << std::fixed << std::setprecision(1) << stats.stddev
+                          << std::setw(12) << std::fixed << std::setprecision(1) << stats.p99
+                          << std::setw(12) << std::fixed << std::setprecision(1) << stats.p999
                           << std::setw(8) << stats.count << std::endl;
             }
         }
@@ -269,16 +896,40 @@ public:
             std::cout << result.devices[i];
         }
         std::cout << "],\n";
+        std::cout << "  \"read_methods\": [";
+        for (size_t i = 0; i < result.methods.size(); ++i) {
+            if (i > 0) std::cout << ", ";
+            std::cout << "\"" << DiffPHCCore::readMethodName(result.methods[i]) << "\"";
+        }
+        std::cout << "],\n";
         
         if (result.success) {
             if (!statistics_only) {
+                const auto& series = result.series;
+                std::cout << "  \"timestamps\": [";
+                for (size_t m = 0; m < series.size(); ++m) {
+                    std::cout << (m > 0 ? ", " : "") << series.timestamp(m);
+                }
+                std::cout << "],\n";
+                std::cout << "  \"lateness\": [";
+                for (size_t m = 0; m < series.size(); ++m) {
+                    std::cout << (m > 0 ? ", " : "") << series.lateness(m);
+                }
+                std::cout << "],\n";
+                std::cout << "  \"valid\": [";
+                for (size_t m = 0; m < series.size(); ++m) {
+                    std::cout << (m > 0 ? ", " : "") << (series.valid(m) ? "true" : "false");
+                }
+                std::cout << "],\n";
+                
+                // Смещения устройств; разности пар восстанавливаются вычитанием
                 std::cout << "  \"measurements\": [\n";
-                for (size_t m = 0; m < result.differences.size(); ++m) {
+                for (size_t m = 0; m < series.size(); ++m) {
                     if (m > 0) std::cout << ",\n";
                     std::cout << "    [";
-                    for (size_t d = 0; d < result.differences[m].size(); ++d) {
+                    for (size_t d = 0; d < series.numDevices(); ++d) {
                         if (d > 0) std::cout << ", ";
-                        std::cout << result.differences[m][d];
+                        std::cout << series.offset(m, d);
                     }
                     std::cout << "]";
                 }
@@ -307,6 +958,11 @@ public:
                         std::cout << "      \"maximum\": " << stats.maximum << ",\n";
                         std::cout << "      \"range\": " << stats.range << ",\n";
                         std::cout << "      \"stddev\": " << stats.stddev << ",\n";
+                        std::cout << "      \"p1\": " << stats.p1 << ",\n";
+                        std::cout << "      \"p5\": " << stats.p5 << ",\n";
+                        std::cout << "      \"p95\": " << stats.p95 << ",\n";
+                        std::cout << "      \"p99\": " << stats.p99 << ",\n";
+                        std::cout << "      \"p99_9\": " << stats.p999 << ",\n";
                         std::cout << "      \"count\": " << stats.count << "\n";
                         std::cout << "    }";
                     }
@@ -314,6 +970,63 @@ public:
                 std::cout << "\n  },\n";
             }
             
+            if (!result.series.empty()) {
+                std::cout << "  \"scheduling\": {\n";
+                std::cout << "    \"period_ns\": " << int64_t(config.delay) * 1000 << ",\n";
+                std::cout << "    \"lateness_mean\": " << result.scheduling.mean << ",\n";
+                std::cout << "    \"lateness_p99\": " << result.scheduling.p99 << ",\n";
+                std::cout << "    \"lateness_max\": " << result.scheduling.maximum << ",\n";
+                std::cout << "    \"lateness_stddev\": " << result.scheduling.stddev << ",\n";
+                std::cout << "    \"missed_deadlines\": " << result.missedDeadlines << "\n";
+                std::cout << "  },\n";
+            }
+            
+            std::cout << "  \"samples_read\": " << result.samplesRead << ",\n";
+            std::cout << "  \"samples_rejected\": " << result.samplesRejected << ",\n";
+            if (baseline_rejection >= 0) {
+                std::cout << "  \"baseline_rejection_rate\": " << baseline_rejection << ",\n";
+            }
+            if (!result.readStats.empty()) {
+                std::cout << "  \"read_stats\": [\n";
+                for (size_t i = 0; i < result.readStats.size(); ++i) {
+                    const auto& rs = result.readStats[i];
+                    std::cout << "    {\"device\": " << result.devices[i]
+                              << ", \"reads\": " << rs.reads
+                              << ", \"errors\": " << rs.errors
+                              << ", \"samples\": " << rs.samples
+                              << ", \"accepted\": " << rs.accepted
+                              << ", \"mean_call_ns\": " << rs.meanCallNs()
+                              << ", \"max_call_ns\": " << rs.callMaxNs
+                              << ", \"mean_delay_ns\": " << rs.meanDelay()
+                              << ", \"min_delay_ns\": " << rs.minDelay << "}"
+                              << (i + 1 < result.readStats.size() ? "," : "") << "\n";
+                }
+                std::cout << "  ],\n";
+            }
+            if (!result.deviceSamples.empty()) {
+                std::cout << "  \"device_samples\": [";
+                for (size_t i = 0; i < result.deviceSamples.size(); ++i) {
+                    std::cout << (i ? ", " : "") << result.deviceSamples[i];
+                }
+                std::cout << "],\n";
+            }
+            
+            if (rollup_report) {
+                outputRollupJSON(*rollup_report, result.devices);
+            }
+            if (window_report) {
+                outputWindowsJSON(*window_report, result.devices);
+            }
+            if (!stability_curves.empty() || !mtie_curves.empty()) {
+                std::cout << "  \"phase_gaps\": " << phase_gaps << ",\n";
+            }
+            if (!stability_curves.empty()) {
+                outputStabilityJSON(result.devices);
+            }
+            if (!mtie_curves.empty()) {
+                outputMtieJSON(result.devices);
+            }
+            
             std::cout << "  \"timestamp\": " << result.baseTimestamp << "\n";
         } else {
             std::cout << "  \"error\": \"" << result.error << "\"\n";
@@ -321,13 +1034,65 @@ public:
         std::cout << "}\n";
     }
 
+    void outputRollupJSON(const PHCRollup& rollup, const std::vector<int>& devices) {
+        const auto level = rollup.levelFor(int64_t(rollup_resolution) * 1000000000LL);
+        std::vector<const PHCRollupBucket*> buckets;
+        rollup.query(level, INT64_MIN, INT64_MAX, buckets);
+        const size_t numDev = std::min(devices.size(), rollup.numDevices());
+
+        std::cout << "  \"rollup\": {\n";
+        std::cout << "    \"width_s\": " << rollup.tier(level).width / 1000000000LL << ",\n";
+        std::cout << "    \"buckets\": [";
+        for (size_t b = 0; b < buckets.size(); ++b) {
+            std::cout << (b ? ",\n" : "\n") << "      {\"start\": " << buckets[b]->start
+                      << ", \"iterations\": " << buckets[b]->iterations << ", \"pairs\": {";
+            bool first = true;
+            for (size_t i = 1; i < numDev; ++i) {
+                for (size_t j = 0; j < i; ++j) {
+                    const auto& c = buckets[b]->cells[PHCRollup::pairIndex(i, j)];
+                    std::cout << (first ? "" : ", ") << "\"ptp" << devices[i] << "-ptp" << devices[j]
+                              << "\": {\"count\": " << c.count << ", \"minimum\": " << c.minimum
+                              << ", \"maximum\": " << c.maximum << ", \"mean\": " << c.mean
+                              << ", \"stddev\": " << c.stddev() << "}";
+                    first = false;
+                }
+            }
+            std::cout << "}}";
+        }
+        std::cout << "\n    ]\n  },\n";
+    }
+
+    void outputCSVHeader(const std::vector<int>& devices) {
+        const int numDev = devices.size();
+        std::cout << "iteration,timestamp,lateness";
+        for (int i = 0; i < numDev; ++i) {
+            std::cout << ",ptp" << devices[i];
+        }
+        for (int i = 0; i < numDev; ++i) {
+            std::cout << ",ptp" << devices[i] << "_error,ptp" << devices[i] << "_accepted"
+                      << ",ptp" << devices[i] << "_delay,ptp" << devices[i] << "_call";
+        }
+        std::cout << "\n";
+    }
+
+    void outputCSVReadings(const PHCReading* readings, size_t numDevices) {
+        for (size_t d = 0; d < numDevices; ++d) {
+            std::cout << "," << readings[d].error << "," << readings[d].accepted
+                      << "," << readings[d].meanDelay << "," << readings[d].callNs;
+        }
+    }
+
     void outputResultsCSV(const PHCResult& result) {
         const auto& devices = result.devices;
         const int numDev = devices.size();
         
+        if (!result.methods.empty()) {
+            outputReadMethods(result, "# ");
+        }
+        
         if (statistics_only) {
             // CSV заголовок для статистики
-            std::cout << "pair,median,mean,minimum,maximum,range,stddev,count\n";
+            std::cout << "pair,median,mean,minimum,maximum,range,stddev,p1,p5,p95,p99,p99_9,count\n";
             
             // Данные статистики
             for (int i = 0; i < numDev; ++i) {
@@ -342,25 +1107,28 @@ public:
                               << stats.maximum << ","
                               << stats.range << ","
                               << stats.stddev << ","
+                              << stats.p1 << "," << stats.p5 << ","
+                              << stats.p95 << "," << stats.p99 << ","
+                              << stats.p999 << ","
                               << stats.count << "\n";
                 }
             }
         } else {
             // CSV заголовок для измерений
-            std::cout << "iteration,timestamp";
-            
-            for (int i = 0; i < numDev; ++i) {
-                for (int j = 0; j <= i; ++j) {
-                    std::cout << ",ptp" << devices[i] << "-ptp" << devices[j];
-                }
-            }
-            std::cout << "\n";
+            outputCSVHeader(devices);
 
             // Данные измерений
-            for (size_t m = 0; m < result.differences.size(); ++m) {
-                std::cout << m << "," << result.baseTimestamp;
-                for (size_t d = 0; d < result.differences[m].size(); ++d) {
-                    std::cout << "," << result.differences[m][d];
+            const auto& series = result.series;
+            for (size_t m = 0; m < series.size(); ++m) {
+                std::cout << series.sequence(m) << "," << series.timestamp(m) << ","
+                          << series.lateness(m);
+                for (size_t d = 0; d < series.numDevices(); ++d) {
+                    std::cout << "," << series.offset(m, d);
+                }
+                for (size_t d = 0; d < series.numDevices(); ++d) {
+                    const auto& r = series.reading(m, d);
+                    std::cout << "," << r.error << "," << r.accepted
+                              << "," << r.meanDelay << "," << r.callNs;
                 }
                 std::cout << "\n";
             }
@@ -368,7 +1136,7 @@ public:
             // Добавить статистику если включена
             if (show_statistics && !result.statistics.empty()) {
                 std::cout << "\n# Статистический анализ\n";
-                std::cout << "pair,median,mean,minimum,maximum,range,stddev,count\n";
+                std::cout << "pair,median,mean,minimum,maximum,range,stddev,p1,p5,p95,p99,p99_9,count\n";
                 
                 for (int i = 0; i < numDev; ++i) {
                     for (int j = 0; j <= i; ++j) {
@@ -382,6 +1150,9 @@ public:
                                   << stats.maximum << ","
                                   << stats.range << ","
                                   << stats.stddev << ","
+                                  << stats.p1 << "," << stats.p5 << ","
+                                  << stats.p95 << "," << stats.p99 << ","
+                                  << stats.p999 << ","
                                   << stats.count << "\n";
                     }
                 }
@@ -389,6 +1160,362 @@ public:
         }
     }
 
+    // Потоковый вывод непрерывного режима: каждая итерация печатается
+    // сразу после чтения; для итоговой статистики в памяти остаются
+    // только последние итерации в кольце ограниченной емкости
+    class StreamingPrinter : public MeasurementSink {
+    public:
+        StreamingPrinter(ShiwaDiffPHCCLI& cli, PHCCompressedSeries* archive)
+            : m_cli(cli), m_archive(archive) {}
+
+        void onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) override {
+            m_devices = devices;
+            m_history.devices = devices;
+            m_history.methods = methods;
+            m_history.interval = int64_t(m_cli.config.delay) * 1000;
+            m_history.series.reset(devices.size());
+            m_history.series.setLimit(DiffPHCCore::historyLimit(m_cli.config));
+            if (m_archive) {
+                m_archive->reset(devices.size());
+                m_history.series.setEvictionSink(m_archive);
+            }
+            if (m_cli.csv_format && !m_cli.json_output) {
+                m_cli.outputCSVHeader(devices);
+            }
+        }
+
+        bool onSample(const PHCSampleView& sample) override {
+            m_history.series.append(sample.sequence, sample.timestamp, sample.lateness,
+                                    sample.offsets, sample.readings);
+            if (m_cli.json_output) {
+                // JSON Lines: один объект на итерацию
+                std::cout << "{\"iteration\": " << sample.sequence
+                          << ", \"timestamp\": " << sample.timestamp
+                          << ", \"lateness\": " << sample.lateness
+                          << ", \"offsets\": [";
+                for (size_t d = 0; d < sample.numDevices; ++d) {
+                    if (d > 0) std::cout << ", ";
+                    std::cout << sample.offsets[d];
+                }
+                std::cout << "], \"valid\": " << (sample.valid ? "true" : "false")
+                          << ", \"readings\": [";
+                for (size_t d = 0; d < sample.numDevices; ++d) {
+                    const auto& r = sample.readings[d];
+                    std::cout << (d > 0 ? ", " : "") << "{\"error\": " << r.error
+                              << ", \"accepted\": " << r.accepted
+                              << ", \"delay\": " << r.meanDelay
+                              << ", \"call_ns\": " << r.callNs << "}";
+                }
+                std::cout << "]}\n";
+            } else if (m_cli.csv_format) {
+                std::cout << sample.sequence << "," << sample.timestamp << "," << sample.lateness;
+                for (size_t d = 0; d < sample.numDevices; ++d) {
+                    std::cout << "," << sample.offsets[d];
+                }
+                m_cli.outputCSVReadings(sample.readings, sample.numDevices);
+                std::cout << "\n";
+            } else if (!m_cli.statistics_only) {
+                m_cli.outputMatrix(m_devices, sample.pairs());
+            }
+            std::cout.flush();
+            return true;
+        }
+
+        PHCResult& history() { return m_history; }
+
+    private:
+        ShiwaDiffPHCCLI& m_cli;
+        PHCCompressedSeries* m_archive;
+        std::vector<int> m_devices;
+        PHCResult m_history;
+    };
+
+    // Скользящие окна непрерывного режима: обновляются каждой итерацией,
+    // выводятся раз в секунду времени измерения (кроме CSV)
+    class WindowReporter : public MeasurementSink {
+    public:
+        WindowReporter(ShiwaDiffPHCCLI& cli, PHCSlidingStats& stats) : m_cli(cli), m_stats(stats) {}
+
+        void onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) override {
+            m_devices = devices;
+            m_nextReport = 0;
+            m_stats.onStart(devices, methods);
+        }
+
+        bool onSample(const PHCSampleView& sample) override {
+            m_stats.onSample(sample);
+            if (m_cli.csv_format && !m_cli.json_output) {
+                return true;
+            }
+            if (m_nextReport == 0) {
+                m_nextReport = sample.timestamp + 1000000000LL;
+            } else if (sample.timestamp >= m_nextReport) {
+                m_cli.outputWindowsLive(m_stats, m_devices);
+                std::cout.flush();
+                m_nextReport += 1000000000LL * ((sample.timestamp - m_nextReport) / 1000000000LL + 1);
+            }
+            return true;
+        }
+
+    private:
+        ShiwaDiffPHCCLI& m_cli;
+        PHCSlidingStats& m_stats;
+        std::vector<int> m_devices;
+        int64_t m_nextReport = 0;
+    };
+
+    int runStreaming() {
+        PHCSession session;
+        std::string error;
+        if (!session.open(config, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+
+        // SIGINT/SIGTERM завершают измерение штатно, со сводкой
+        struct sigaction sa = {};
+        sa.sa_handler = onStopSignal;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+
+        PHCRecordingWriter recorder;
+        if (!record_file.empty() && !recorder.open(record_file, config, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+
+        PHCCompressedSeries archive;
+        StreamingPrinter printer(*this, compress ? &archive : nullptr);
+        PHCRollup rollup;
+        PHCSlidingStats windowStats;
+        WindowReporter windowReporter(*this, windowStats);
+        PHCStabilitySink stabilitySink(double(config.delay) * 1000);
+        PHCMtieSink mtieSink(double(config.delay) * 1000);
+        PHCMultiSink sinks;
+        sinks.add(&printer);
+        if (!record_file.empty()) {
+            sinks.add(&recorder);
+        }
+        if (rollup_resolution > 0) {
+            sinks.add(&rollup);
+        }
+        if (windows) {
+            sinks.add(&windowReporter);
+        }
+        if (stability) {
+            sinks.add(&stabilitySink);
+        }
+        if (mtie) {
+            sinks.add(&mtieSink);
+        }
+        auto summary = session.run(sinks, &stop_requested);
+        if (!summary.success) {
+            std::cerr << "Error: " << summary.error << std::endl;
+            return 1;
+        }
+        if (!recorder.error().empty()) {
+            std::cerr << "Error: " << recorder.error() << std::endl;
+            return 1;
+        }
+
+        if (show_statistics && !json_output && !csv_format) {
+            // Сводка по всем итерациям; медиана - по оставшимся в кольце истории
+            auto& history = printer.history();
+            history.success = true;
+            history.missedDeadlines = summary.missedDeadlines;
+            history.samplesRead = summary.samplesRead;
+            history.samplesRejected = summary.samplesRejected;
+            history.readStats = summary.readStats;
+            history.deviceSamples = summary.deviceSamples;
+            history.running = summary.running;
+            archived_rows = archive.size();
+            DiffPHCCore::calculateResultStatistics(history, compress ? &archive : nullptr);
+            if (!history.statistics.empty()) {
+                outputStatistics(history);
+            }
+        }
+        if (rollup_resolution > 0) {
+            outputRollup(rollup, summary.devices);
+        }
+        if (windows) {
+            outputWindows(windowStats, summary.devices);
+        }
+        if (stability) {
+            collectStability(stabilitySink);
+            outputStability(summary.devices);
+        }
+        if (mtie) {
+            collectMtie(mtieSink);
+            outputMtie(summary.devices);
+        }
+
+        if (verbose) {
+            std::cerr << "Пропущено дедлайнов: " << summary.missedDeadlines
+                      << ", отброшено отсчетов: " << summary.samplesRejected
+                      << " из " << summary.samplesRead << std::endl;
+            for (size_t i = 0; i < summary.readStats.size(); ++i) {
+                std::cerr << "Чтение ptp" << summary.devices[i] << ": ошибок "
+                          << summary.readStats[i].errors << " из " << summary.readStats[i].reads
+                          << ", длительность ср. " << summary.readStats[i].meanCallNs() << " нс"
+                          << std::endl;
+            }
+            if (compress && !archive.empty()) {
+                size_t raw = archive.size() * PHCSeries::bytesPerRow(archive.numDevices());
+                std::cerr << "Сжатый архив: " << archive.size() << " итераций в "
+                          << archive.blockCount() << " блоках, " << archive.bytes() << " байт ("
+                          << std::fixed << std::setprecision(1)
+                          << double(archive.bytes()) / archive.size() << " байт/итерация, сжатие "
+                          << double(raw) / archive.bytes() << "x)" << std::endl;
+            }
+        }
+        return mtie_failed ? 4 : 0;
+    }
+
+    // Приемник воспроизведения: собирает итерации в PHCResult так же, как
+    // живое измерение, вместе со сводкой чтений по устройствам
+    class ReplayCollector : public MeasurementSink {
+    public:
+        ReplayCollector(PHCResult& result, PHCCompressedSeries* archive, size_t limit, int64_t period)
+            : m_result(result), m_archive(archive), m_limit(limit), m_period(period) {}
+
+        void onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) override {
+            m_result.devices = devices;
+            m_result.methods = methods;
+            m_result.interval = m_period;
+            m_result.series.reset(devices.size());
+            m_result.series.setLimit(m_limit);
+            if (m_archive) {
+                m_archive->reset(devices.size());
+                m_result.series.setEvictionSink(m_archive);
+            }
+            m_result.readStats.assign(devices.size(), PHCDeviceReadStats());
+            m_result.deviceSamples.assign(devices.size(), 0);
+            m_result.running.reset(devices.size());
+        }
+
+        bool onSample(const PHCSampleView& sample) override {
+            m_result.series.append(sample.sequence, sample.timestamp, sample.lateness,
+                                   sample.offsets, sample.readings);
+            m_result.running.add(sample.lateness, sample.pairs(), sample.valid);
+            for (size_t d = 0; d < sample.numDevices; ++d) {
+                const auto& r = sample.readings[d];
+                m_result.readStats[d].add(r);
+                m_result.samplesRead += r.samples;
+                m_result.samplesRejected += r.samples - r.accepted;
+                m_result.deviceSamples[d] = r.samples;
+                m_metadata = m_metadata || r.samples || r.callNs;
+            }
+            // Пропущенные дедлайны видны как разрывы сетки меток времени
+            if (m_rows++ > 0 && m_period > 0) {
+                int64_t gap = sample.timestamp - m_result.baseTimestamp;
+                if (gap > m_period + m_period / 2) {
+                    m_result.missedDeadlines += (gap + m_period / 2) / m_period - 1;
+                }
+            }
+            m_result.baseTimestamp = sample.timestamp;
+            return true;
+        }
+
+        void onStop() override {
+            // Формат без метаданных чтения (JSON): сводка чтений не выводится
+            if (!m_metadata) {
+                m_result.readStats.clear();
+                m_result.deviceSamples.clear();
+            }
+        }
+
+    private:
+        PHCResult& m_result;
+        PHCCompressedSeries* m_archive;
+        size_t m_limit;
+        int64_t m_period;
+        uint64_t m_rows = 0;
+        bool m_metadata = false;
+    };
+
+    int runReplay() {
+        PHCReplay replay;
+        std::string error;
+        if (!replay.open(replay_file, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+
+        // Интервал исходного измерения нужен для сводки планировщика
+        config.delay = replay.config().delay;
+        if (verbose) {
+            std::cerr << "Воспроизведение " << replay_file << " ("
+                      << PHCReplay::formatName(replay.format()) << "): устройства";
+            for (auto d : replay.devices()) {
+                std::cerr << " ptp" << d;
+            }
+            std::cerr << ", интервал " << config.delay << " мкс" << std::endl;
+        }
+
+        PHCResult result;
+        PHCCompressedSeries archive;
+        PHCConfig limits = config;
+        limits.count = 1;       // Без ограничения истории, если оно не задано явно
+        limits.devices = replay.devices();
+        ReplayCollector collector(result, compress ? &archive : nullptr,
+                                  config.historySize || config.historyMemory ? DiffPHCCore::historyLimit(limits) : 0,
+                                  int64_t(config.delay) * 1000);
+        PHCRollup rollup;
+        PHCSlidingStats windowStats;
+        PHCStabilitySink stabilitySink(double(config.delay) * 1000);
+        PHCMtieSink mtieSink(double(config.delay) * 1000);
+        PHCMultiSink sinks;
+        sinks.add(&collector);
+        if (rollup_resolution > 0) {
+            sinks.add(&rollup);
+            rollup_report = &rollup;
+        }
+        if (windows) {
+            sinks.add(&windowStats);
+            window_report = &windowStats;
+        }
+        if (stability) {
+            sinks.add(&stabilitySink);
+        }
+        if (mtie) {
+            sinks.add(&mtieSink);
+        }
+        if (!replay.run(sinks, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        if (stability) {
+            collectStability(stabilitySink);
+        }
+        if (mtie) {
+            collectMtie(mtieSink);
+        }
+
+        // Номера устройств из -d заменяют номера сохраненного сеанса
+        if (config.devices.size() == result.devices.size()) {
+            result.devices = config.devices;
+        }
+        config.devices = result.devices;
+
+        result.success = true;
+        archived_rows = archive.size();
+        DiffPHCCore::calculateResultStatistics(result, compress ? &archive : nullptr);
+
+        if (!output_file.empty() && freopen(output_file.c_str(), "w", stdout) == nullptr) {
+            std::cerr << "Error: failed to redirect output to file '" << output_file << "'" << std::endl;
+            return 1;
+        }
+        outputResults(result);
+        return mtie_failed ? 4 : 0;
+    }
+
+    static void onStopSignal(int) {
+        stop_requested.store(true);
+    }
+
+    static std::atomic<bool> stop_requested;
+
     int optArgToInt() {
         try {
             return std::stoi(optarg);
@@ -398,8 +1525,125 @@ public:
         }
     }
 
+    std::vector<int> optArgToIntList() {
+        std::vector<int> values;
+        std::stringstream ss(optarg);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            try {
+                values.push_back(std::stoi(item));
+            } catch (...) {
+                std::cerr << "Error: invalid argument '" << optarg << "'" << std::endl;
+                exit(-1);
+            }
+        }
+        return values;
+    }
+
+    // Формат: NAME для всех устройств или DEV:NAME для одного устройства
+    bool parseMethodArg(const std::string& arg) {
+        auto colon = arg.find(':');
+        if (colon == std::string::npos) {
+            return DiffPHCCore::parseReadMethod(arg, config.method);
+        }
+        PHCReadMethod method;
+        if (!DiffPHCCore::parseReadMethod(arg.substr(colon + 1), method)) {
+            return false;
+        }
+        try {
+            config.deviceMethods[std::stoi(arg.substr(0, colon))] = method;
+        } catch (...) {
+            return false;
+        }
+        return true;
+    }
+
+    // Формат: SPEC для всех устройств или DEV:SPEC для одного устройства
+    bool parseSimulateArg(const std::string& arg, std::string& error) {
+        config.simulate = true;
+        auto colon = arg.find(':');
+        if (colon == std::string::npos) {
+            return PHCSimulatedSource::parseParams(arg, config.simulation, error);
+        }
+        int device;
+        try {
+            device = std::stoi(arg.substr(0, colon));
+        } catch (...) {
+            error = "Invalid device in '" + arg + "'";
+            return false;
+        }
+        PHCSimulationParams params = config.simulation;
+        if (!PHCSimulatedSource::parseParams(arg.substr(colon + 1), params, error)) {
+            return false;
+        }
+        config.deviceSimulation[device] = params;
+        return true;
+    }
+
+    void runBenchmark() {
+        auto devices = config.devices.empty() ? DiffPHCCore::getAvailablePHCDevices() : config.devices;
+        int iterations = config.count > 0 ? config.count : 1000;
+        
+        std::cout << "Сравнение способов чтения PHC (" << iterations << " вызовов, "
+                  << config.samples << " отсчетов)" << std::endl;
+        for (int device : devices) {
+            std::string error;
+            auto source = PHCClockSource::open(device, config, error);
+            if (!source) {
+                std::cerr << "Error: " << error << std::endl;
+                continue;
+            }
+            auto results = DiffPHCCore::benchmarkReadMethods(*source, iterations, config.samples);
+            
+            std::cout << "\n" << source->name() << std::endl;
+            std::cout << std::left << std::setw(12) << "Способ"
+                      << std::setw(14) << "Среднее, нс"
+                      << std::setw(14) << "Минимум, нс"
+                      << std::setw(14) << "Медиана, нс"
+                      << std::setw(14) << "Разброс, нс" << std::endl;
+            std::cout << std::string(68, '-') << std::endl;
+            for (const auto& r : results) {
+                std::cout << std::left << std::setw(12) << DiffPHCCore::readMethodName(r.method);
+                if (!r.supported) {
+                    std::cout << "не поддерживается" << std::endl;
+                    continue;
+                }
+                std::cout << std::setw(14) << std::fixed << std::setprecision(1) << r.meanCallNs
+                          << std::setw(14) << r.minCallNs
+                          << std::setw(14) << std::fixed << std::setprecision(1) << r.medianCallNs
+                          << std::setw(14) << std::fixed << std::setprecision(1) << r.offsetStdDev
+                          << std::endl;
+            }
+        }
+    }
+
+    void runKernelBenchmark() {
+        size_t values = config.count > 0 ? size_t(config.count) : size_t(1) << 22;
+        auto results = PHCKernels::benchmark(values, 5);
+        
+        std::cout << "Векторные ядра статистики (" << values << " значений int64, выбрано: "
+                  << PHCKernels::isaName(PHCKernels::isa()) << ")" << std::endl;
+        // Заголовок одной строкой: setw считает байты UTF-8, а не символы
+        std::cout << "Ядра      Сумма, нс     Квадраты, нс  Min/max, нс   В double, нс  Ускорение Ошибка суммы" << std::endl;
+        std::cout << std::string(90, '-') << std::endl;
+        const double scalar = results.front().sumNs + results.front().sumSquaresNs + results.front().minmaxNs;
+        for (const auto& r : results) {
+            // Ускорение прохода статистики: сумма, квадраты и min/max
+            const double speedup = scalar / (r.sumNs + r.sumSquaresNs + r.minmaxNs);
+            std::cout << std::left << std::setw(10) << PHCKernels::isaName(r.isa)
+                      << std::fixed << std::setprecision(3)
+                      << std::setw(14) << r.sumNs
+                      << std::setw(14) << r.sumSquaresNs
+                      << std::setw(14) << r.minmaxNs
+                      << std::setw(14) << r.toDoubleNs
+                      << std::setprecision(2) << std::setw(10) << speedup
+                      << std::scientific << std::setprecision(1) << r.sumError
+                      << std::defaultfloat << std::endl;
+        }
+        std::cout << "(нс на значение, лучшее из 5 повторов)" << std::endl;
+    }
+
     int parseArgs(int argc, char** argv) {
-        [[maybe_unused]] bool csv_format = false; // TODO: implement CSV format support
         [[maybe_unused]] int precision = 0; // TODO: implement precision setting
 
         struct option longopts[] = {
@@ -421,6 +1665,28 @@ public:
             {"stats", 0, nullptr, 1005},
             {"no-stats", 0, nullptr, 1006},
             {"stats-only", 0, nullptr, 1007},
+            {"parallel", 0, nullptr, 1008},
+            {"cpus", 1, nullptr, 1009},
+            {"method", 1, nullptr, 1010},
+            {"benchmark", 0, nullptr, 1011},
+            {"realtime", 0, nullptr, 1012},
+            {"rt-priority", 1, nullptr, 1013},
+            {"cpu", 1, nullptr, 1014},
+            {"adaptive", 0, nullptr, 1015},
+            {"target-uncertainty", 1, nullptr, 1016},
+            {"simulate", 1, nullptr, 1017},
+            {"history", 1, nullptr, 1018},
+            {"history-memory", 1, nullptr, 1019},
+            {"compress", 0, nullptr, 1020},
+            {"record", 1, nullptr, 1021},
+            {"replay", 1, nullptr, 1022},
+            {"rollup", 1, nullptr, 1023},
+            {"stability", 0, nullptr, 1024},
+            {"mtie", 0, nullptr, 1025},
+            {"mtie-mask", 1, nullptr, 1026},
+            {"windows", 0, nullptr, 1027},
+            {"benchmark-kernels", 0, nullptr, 1028},
+            {"rt-baseline", 1, nullptr, 1029},
             {0, 0, 0, 0}
         };
 
@@ -484,6 +1750,86 @@ public:
                     statistics_only = true;
                     show_statistics = true;
                     break;
+                case 1008: // --parallel
+                    config.parallel = true;
+                    break;
+                case 1009: // --cpus
+                    config.cpus = optArgToIntList();
+                    break;
+                case 1010: // --method
+                    if (!parseMethodArg(optarg)) {
+                        std::cerr << "Error: unknown read method '" << optarg << "'" << std::endl;
+                        return -1;
+                    }
+                    break;
+                case 1011: // --benchmark
+                    benchmark = true;
+                    break;
+                case 1012: // --realtime
+                    config.realtime = true;
+                    break;
+                case 1013: // --rt-priority
+                    config.rtPriority = optArgToInt();
+                    break;
+                case 1014: // --cpu
+                    config.rtCpu = optArgToInt();
+                    break;
+                case 1015: // --adaptive
+                    config.adaptiveSamples = true;
+                    break;
+                case 1016: // --target-uncertainty
+                    config.targetUncertainty = optArgToInt();
+                    break;
+                case 1017: { // --simulate
+                    std::string error;
+                    if (!parseSimulateArg(optarg, error)) {
+                        std::cerr << "Error: " << error << std::endl;
+                        return -1;
+                    }
+                    break;
+                }
+                case 1018: // --history
+                    config.historySize = std::max(0, optArgToInt());
+                    break;
+                case 1019: // --history-memory
+                    config.historyMemory = size_t(std::max(0, optArgToInt())) << 20;
+                    break;
+                case 1020: // --compress
+                    compress = true;
+                    break;
+                case 1021: // --record
+                    record_file = optarg;
+                    break;
+                case 1022: // --replay
+                    replay_file = optarg;
+                    break;
+                case 1023: // --rollup
+                    rollup_resolution = std::max(1, optArgToInt());
+                    break;
+                case 1024: // --stability
+                    stability = true;
+                    break;
+                case 1025: // --mtie
+                    mtie = true;
+                    break;
+                case 1026: { // --mtie-mask
+                    std::string error;
+                    if (!mtie_mask.parse(optarg, error)) {
+                        std::cerr << "Error: " << error << std::endl;
+                        return -1;
+                    }
+                    mtie = true;
+                    break;
+                }
+                case 1027: // --windows
+                    windows = true;
+                    break;
+                case 1028: // --benchmark-kernels
+                    benchmark_kernels = true;
+                    break;
+                case 1029: // --rt-baseline
+                    baseline_count = std::max(0, optArgToInt());
+                    break;
                 case 0:
                     break;
                 case '?':
@@ -493,6 +1839,16 @@ public:
             }
         }
 
+        if (benchmark) {
+            runBenchmark();
+            return 0;
+        }
+
+        if (benchmark_kernels) {
+            runKernelBenchmark();
+            return 0;
+        }
+
         if (config.info) {
             if (config.devices.empty()) {
                 DiffPHCCore::printClockInfoAll();
@@ -506,8 +1862,15 @@ public:
             return 0;
         }
 
+        // Устройства воспроизведения определяет сохраненный сеанс
+        if (!replay_file.empty()) {
+            return 1;
+        }
+
         // Auto-detect devices if none specified
-        if (config.devices.empty()) {
+        if (config.devices.empty() && config.simulate) {
+            config.devices = {0, 1};
+        } else if (config.devices.empty()) {
             auto available = DiffPHCCore::getAvailablePHCDevices();
             if (available.size() >= 2) {
                 config.devices.push_back(available[0]);
@@ -532,16 +1895,22 @@ public:
             return -parse_result;
         }
 
-        if (DiffPHCCore::requiresRoot()) {
-            std::cerr << "Error: Root privileges required to access PTP devices" << std::endl;
-            return 2;
+        if (!replay_file.empty()) {
+            return runReplay();
         }
 
-        // Check if PTP devices are available
-        std::string ptp_error;
-        if (!DiffPHCCore::checkPTPDevicesAvailable(ptp_error)) {
-            std::cerr << "Error: " << ptp_error << std::endl;
-            return 3;
+        if (!config.simulate) {
+            if (DiffPHCCore::requiresRoot()) {
+                std::cerr << "Error: Root privileges required to access PTP devices" << std::endl;
+                return 2;
+            }
+
+            // Check if PTP devices are available
+            std::string ptp_error;
+            if (!DiffPHCCore::checkPTPDevicesAvailable(ptp_error)) {
+                std::cerr << "Error: " << ptp_error << std::endl;
+                return 3;
+            }
         }
 
         if (verbose) {
@@ -549,6 +1918,16 @@ public:
             std::cout << "  Iterations: " << (config.count == 0 ? "infinite" : std::to_string(config.count)) << std::endl;
             std::cout << "  Delay: " << config.delay << " μs" << std::endl;
             std::cout << "  Samples: " << config.samples << std::endl;
+            std::cout << "  Acquisition: " << (config.parallel ? "parallel" : "sequential") << std::endl;
+            std::cout << "  Read method: " << DiffPHCCore::readMethodName(config.method) << std::endl;
+            if (config.simulate) {
+                std::cout << "  Clock source: simulated" << std::endl;
+            }
+            if (config.realtime) {
+                std::cout << "  Realtime: SCHED_FIFO " << config.rtPriority
+                          << (config.rtCpu >= 0 ? ", CPU " + std::to_string(config.rtCpu) : std::string())
+                          << std::endl;
+            }
             std::cout << "  Devices: ";
             for (auto d : config.devices) {
                 std::cout << "ptp" << d << " ";
@@ -556,7 +1935,84 @@ public:
             std::cout << std::endl << std::endl;
         }
 
-        auto result = DiffPHCCore::measurePHCDifferences(config);
+        if (config.realtime && baseline_count > 0) {
+            // Прогон без realtime с тем же интервалом и числом отсчетов для
+            // сравнения доли отброшенных отсчетов
+            PHCConfig baselineConfig = config;
+            baselineConfig.realtime = false;
+            baselineConfig.count = baseline_count;
+            auto baseline = DiffPHCCore::measurePHCDifferences(baselineConfig);
+            if (baseline.success) {
+                baseline_rejection = rejectionRate(baseline);
+            }
+        }
+
+        if (config.count == 0) {
+            if (!output_file.empty() && freopen(output_file.c_str(), "w", stdout) == nullptr) {
+                std::cerr << "Error: failed to redirect output to file '" << output_file << "'" << std::endl;
+                return 1;
+            }
+            return runStreaming();
+        }
+
+        // Запись, агрегация, окна, кривые стабильности и MTIE получают
+        // каждую итерацию во время измерения, поэтому охватывают весь прогон,
+        // даже если --history хранит только последние
+        PHCResult result;
+        PHCRecordingWriter recorder;
+        PHCRollup rollup;
+        PHCSlidingStats windowStats;
+        PHCStabilitySink stabilitySink(double(config.delay) * 1000);
+        PHCMtieSink mtieSink(double(config.delay) * 1000);
+        PHCSession session;
+        std::string error;
+        if (session.open(config, error)) {
+            if (!record_file.empty() && !recorder.open(record_file, config, error)) {
+                std::cerr << "Error: " << error << std::endl;
+                return 1;
+            }
+            PHCResultCollector collector(result, DiffPHCCore::historyLimit(config), config.count);
+            PHCMultiSink sinks;
+            sinks.add(&collector);
+            if (!record_file.empty()) {
+                sinks.add(&recorder);
+            }
+            if (rollup_resolution > 0) {
+                sinks.add(&rollup);
+            }
+            if (windows) {
+                sinks.add(&windowStats);
+            }
+            if (stability) {
+                sinks.add(&stabilitySink);
+            }
+            if (mtie) {
+                sinks.add(&mtieSink);
+            }
+            PHCResult summary = session.run(sinks);
+            collector.finish(summary);
+            if (!recorder.error().empty()) {
+                std::cerr << "Error: " << recorder.error() << std::endl;
+                return 1;
+            }
+        } else {
+            result.success = false;
+            result.devices = config.devices;
+            result.error = error;
+        }
+        
+        if (result.success && rollup_resolution > 0) {
+            rollup_report = &rollup;
+        }
+        if (result.success && windows) {
+            window_report = &windowStats;
+        }
+        if (result.success && stability) {
+            collectStability(stabilitySink);
+        }
+        if (result.success && mtie) {
+            collectMtie(mtieSink);
+        }
         
         if (!output_file.empty()) {
             if (freopen(output_file.c_str(), "w", stdout) == nullptr) {
@@ -567,10 +2023,15 @@ public:
 
         outputResults(result);
         
-        return result.success ? 0 : 1;
+        if (!result.success) {
+            return 1;
+        }
+        return mtie_failed ? 4 : 0;
     }
 };
 
+std::atomic<bool> ShiwaDiffPHCCLI::stop_requested{false};
+
 int main(int argc, char** argv) {
     ShiwaDiffPHCCLI cli;
     return cli.run(argc, argv);
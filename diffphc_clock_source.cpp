@@ -0,0 +1,239 @@
+#include "diffphc_clock_source.h"
+#include <cerrno>
+#include <cmath>
+
+// PHCClockSource implementation
+PHCReadMethod PHCClockSource::probeReadMethod() {
+    // Порядок предпочтения: наименьшая ошибка измерения первой
+    for (auto method : {PHCReadMethod::Precise, PHCReadMethod::Extended, PHCReadMethod::Basic}) {
+        if (supportsReadMethod(method)) {
+            return method;
+        }
+    }
+    return PHCReadMethod::None;
+}
+
+std::unique_ptr<PHCClockSource> PHCClockSource::open(int phc_index, const PHCConfig& config,
+                                                     std::string& error) {
+    if (config.simulate) {
+        auto params = config.simulation;
+        auto it = config.deviceSimulation.find(phc_index);
+        if (it != config.deviceSimulation.end()) {
+            params = it->second;
+        }
+        return std::make_unique<PHCSimulatedSource>(phc_index, params, int64_t(config.delay) * 1000);
+    }
+
+    auto source = std::make_unique<PHCHardwareSource>();
+    if (!source->open(phc_index, error)) {
+        return nullptr;
+    }
+    return source;
+}
+
+std::string PHCClockSource::sourceName(int phc_index, const PHCConfig& config) {
+    return config.simulate ? "sim:ptp" + std::to_string(phc_index)
+                           : DiffPHCCore::getPHCFileName(phc_index);
+}
+
+// PHCHardwareSource implementation
+PHCHardwareSource::~PHCHardwareSource() {
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+bool PHCHardwareSource::open(int phc_index, std::string& error) {
+    m_name = DiffPHCCore::getPHCFileName(phc_index);
+    m_fd = DiffPHCCore::openPHC(m_name);
+    if (m_fd < 0) {
+        error = "PTP device " + m_name + " not found or not accessible";
+        return false;
+    }
+    return true;
+}
+
+ptp_clock_caps PHCHardwareSource::capabilities() {
+    ptp_clock_caps caps = {};
+    if (ioctl(m_fd, PTP_CLOCK_GETCAPS, &caps)) {
+        caps = {};
+    }
+    return caps;
+}
+
+bool PHCHardwareSource::supportsReadMethod(PHCReadMethod method) {
+    return DiffPHCCore::supportsReadMethod(m_fd, method);
+}
+
+PHCReading PHCHardwareSource::read(PHCReadMethod method, int samples) {
+    return DiffPHCCore::readPHC(m_fd, method, samples);
+}
+
+// PHCSimulatedSource implementation
+PHCSimulatedSource::PHCSimulatedSource(int phc_index, const PHCSimulationParams& params,
+                                       int64_t period)
+    : m_index(phc_index),
+      m_params(params),
+      m_rng(params.seed + phc_index),
+      m_jitter(1.0 / (params.latencyJitter > 0 ? params.latencyJitter : 1.0)),
+      m_period(std::max<int64_t>(0, period)),
+      m_phase(double(params.offset)) {
+}
+
+std::string PHCSimulatedSource::name() const {
+    PHCConfig config;
+    config.simulate = true;
+    return sourceName(m_index, config);
+}
+
+ptp_clock_caps PHCSimulatedSource::capabilities() {
+    ptp_clock_caps caps = {};
+    caps.max_adj = 500000000;
+    return caps;
+}
+
+bool PHCSimulatedSource::supportsReadMethod(PHCReadMethod method) {
+    switch (method) {
+        case PHCReadMethod::Precise:
+            return m_params.precise;
+        case PHCReadMethod::Extended:
+        case PHCReadMethod::Basic:
+        case PHCReadMethod::Direct:
+            return true;
+        default:
+            return false;
+    }
+}
+
+PHCReading PHCSimulatedSource::read(PHCReadMethod method, int samples) {
+    PHCReading reading;
+    if (!supportsReadMethod(method)) {
+        reading.error = EOPNOTSUPP;
+        return reading;
+    }
+
+    // Чтение начинается в плановый момент; задержка вызова тратится из
+    // модельного времени и сдвигает следующее чтение, если превысила шаг
+    const int64_t start = std::max(m_next, m_now);
+    m_next += m_period;
+    advance(start);
+    const int64_t phase = std::llround(m_phase);
+
+    if (method == PHCReadMethod::Precise) {
+        reading.samples = 1;
+        reading.accepted = 1;
+        reading.callNs = latency();
+        reading.offset = phase;
+        m_now = start + reading.callNs;
+        return reading;
+    }
+
+    int64_t t0[PTP_MAX_SAMPLES];
+    int64_t t1[PTP_MAX_SAMPLES];
+    int64_t t2[PTP_MAX_SAMPLES];
+    samples = std::max(1, std::min(PTP_MAX_SAMPLES, samples));
+
+    int64_t t = start;
+    for (int i = 0; i < samples; ++i) {
+        int64_t delay = latency();
+        t0[i] = t;
+        t1[i] = t + int64_t(m_uniform(m_rng) * delay) + phase;
+        t2[i] = t + delay;
+        t = t2[i] + m_params.latencyMin / 4;
+    }
+    reading.callNs = t - start;
+    m_now = t;
+
+    DiffPHCCore::estimateOffset(t0, t1, t2, samples, reading);
+    return reading;
+}
+
+int64_t PHCSimulatedSource::trueOffset() const {
+    return std::llround(m_phase);
+}
+
+void PHCSimulatedSource::advance(int64_t now) {
+    double dt = (now - m_last) / 1e9;
+    if (dt <= 0) {
+        return;
+    }
+    m_last = now;
+
+    if (m_params.wander > 0) {
+        m_wander += m_params.wander * std::sqrt(dt) * m_normal(m_rng);
+    }
+    m_phase += (m_params.drift + m_wander) * dt;
+
+    if (m_params.stepInterval > 0 &&
+        m_uniform(m_rng) < 1.0 - std::exp(-dt / m_params.stepInterval)) {
+        m_phase += (m_uniform(m_rng) < 0.5 ? -1.0 : 1.0) * m_params.stepSize;
+    }
+}
+
+int64_t PHCSimulatedSource::latency() {
+    double delay = m_params.latencyMin;
+    if (m_params.latencyJitter > 0) {
+        delay += m_jitter(m_rng);
+    }
+    if (m_params.outlierRate > 0 && m_uniform(m_rng) < m_params.outlierRate) {
+        delay += m_params.outlierLatency;
+    }
+    return std::max<int64_t>(1, int64_t(delay));
+}
+
+bool PHCSimulatedSource::parseParams(const std::string& spec, PHCSimulationParams& params,
+                                     std::string& error) {
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        auto eq = item.find('=');
+        if (eq == std::string::npos) {
+            error = "Invalid simulation parameter '" + item + "': expected key=value";
+            return false;
+        }
+        std::string key = item.substr(0, eq);
+        std::string value = item.substr(eq + 1);
+        try {
+            if (key == "offset") {
+                params.offset = std::stoll(value);
+            } else if (key == "drift") {
+                params.drift = std::stod(value);
+            } else if (key == "wander") {
+                params.wander = std::stod(value);
+            } else if (key == "step-interval") {
+                params.stepInterval = std::stod(value);
+            } else if (key == "step") {
+                params.stepSize = std::stoll(value);
+            } else if (key == "latency") {
+                params.latencyMin = std::stoll(value);
+            } else if (key == "jitter") {
+                params.latencyJitter = std::stod(value);
+            } else if (key == "outliers") {
+                params.outlierRate = std::stod(value);
+            } else if (key == "outlier-latency") {
+                params.outlierLatency = std::stoll(value);
+            } else if (key == "precise") {
+                params.precise = std::stoi(value) != 0;
+            } else if (key == "seed") {
+                params.seed = std::stoull(value);
+            } else {
+                error = "Unknown simulation parameter '" + key + "'";
+                return false;
+            }
+        } catch (...) {
+            error = "Invalid value for simulation parameter '" + key + "': '" + value + "'";
+            return false;
+        }
+    }
+
+    if (params.latencyMin < 1 || params.latencyJitter < 0 || params.outlierRate < 0 ||
+        params.outlierRate > 1 || params.stepInterval < 0 || params.wander < 0) {
+        error = "Invalid simulation parameters: latency >= 1, jitter/wander/step-interval >= 0, "
+                "outliers in 0..1";
+        return false;
+    }
+    return true;
+}
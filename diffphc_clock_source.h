@@ -0,0 +1,93 @@
+#ifndef DIFFPHC_CLOCK_SOURCE_H
+#define DIFFPHC_CLOCK_SOURCE_H
+
+#include "diffphc_core.h"
+#include <random>
+
+// Источник времени PHC, с которым работает PHCSession: аппаратное
+// устройство /dev/ptpN или модель часов. Один источник читается не
+// более чем одним потоком одновременно.
+class PHCClockSource {
+public:
+    virtual ~PHCClockSource() = default;
+
+    virtual std::string name() const = 0;
+    virtual ptp_clock_caps capabilities() = 0;
+    virtual bool supportsReadMethod(PHCReadMethod method) = 0;
+    virtual PHCReading read(PHCReadMethod method, int samples) = 0;
+
+    // Лучший поддерживаемый способ чтения (Precise, Extended, Basic)
+    PHCReadMethod probeReadMethod();
+
+    // Открыть устройство phc_index: /dev/ptpN или его модель при config.simulate
+    static std::unique_ptr<PHCClockSource> open(int phc_index, const PHCConfig& config,
+                                                std::string& error);
+    // Имя источника, который open() создаст для phc_index
+    static std::string sourceName(int phc_index, const PHCConfig& config);
+};
+
+// Аппаратный PHC: ioctl PTP_SYS_OFFSET* и clock_gettime() по дескриптору
+class PHCHardwareSource : public PHCClockSource {
+public:
+    PHCHardwareSource() = default;
+    ~PHCHardwareSource() override;
+    PHCHardwareSource(const PHCHardwareSource&) = delete;
+    PHCHardwareSource& operator=(const PHCHardwareSource&) = delete;
+
+    bool open(int phc_index, std::string& error);
+    int fd() const { return m_fd; }
+
+    std::string name() const override { return m_name; }
+    ptp_clock_caps capabilities() override;
+    bool supportsReadMethod(PHCReadMethod method) override;
+    PHCReading read(PHCReadMethod method, int samples) override;
+
+private:
+    int m_fd = -1;
+    std::string m_name;
+};
+
+// Модель PHC: начальное смещение, уход и случайное блуждание частоты,
+// скачки фазы (пуассоновский поток) и задержка вызова как минимум плюс
+// экспоненциальный хвост с редкими выбросами. Момент чтения PHC
+// равномерно распределен внутри окна вызова, поэтому ошибка оценки
+// растет с задержкой, как у реальных драйверов. Модель идет по своему
+// времени: каждое чтение начинается в следующий плановый момент (шаг
+// period) или по окончании прошлого вызова, если он не уложился в шаг.
+// Поэтому при одном зерне смещения повторяются от прогона к прогону.
+class PHCSimulatedSource : public PHCClockSource {
+public:
+    PHCSimulatedSource(int phc_index, const PHCSimulationParams& params, int64_t period);
+
+    std::string name() const override;
+    ptp_clock_caps capabilities() override;
+    bool supportsReadMethod(PHCReadMethod method) override;
+    PHCReading read(PHCReadMethod method, int samples) override;
+
+    // Истинное смещение модели в момент последнего чтения (нс)
+    int64_t trueOffset() const;
+
+    // Формат: key=value через запятую, например "offset=1000,drift=50,seed=7".
+    // Ключи: offset, drift, wander, step-interval, step, latency, jitter,
+    // outliers, outlier-latency, precise, seed.
+    static bool parseParams(const std::string& spec, PHCSimulationParams& params, std::string& error);
+
+private:
+    void advance(int64_t now);
+    int64_t latency();
+
+    int m_index;
+    PHCSimulationParams m_params;
+    std::mt19937_64 m_rng;
+    std::normal_distribution<double> m_normal{0.0, 1.0};
+    std::uniform_real_distribution<double> m_uniform{0.0, 1.0};
+    std::exponential_distribution<double> m_jitter;
+    int64_t m_period;           // Плановый интервал между чтениями (нс)
+    int64_t m_next = 0;         // Плановый момент следующего чтения
+    int64_t m_now = 0;          // Модельное время: конец последнего вызова
+    int64_t m_last = 0;         // Момент последнего продвижения модели
+    double m_phase;             // Текущее смещение фазы (нс)
+    double m_wander = 0.0;      // Накопленное блуждание частоты (ppb)
+};
+
+#endif // DIFFPHC_CLOCK_SOURCE_H
@@ -0,0 +1,226 @@
+#include "diffphc_compressed.h"
+#include <algorithm>
+
+namespace {
+
+// Разности считаются по модулю 2^64: кодирование обратимо при любом переполнении
+inline int64_t wrapSub(int64_t a, int64_t b) {
+    return int64_t(uint64_t(a) - uint64_t(b));
+}
+
+inline int64_t wrapAdd(int64_t a, int64_t b) {
+    return int64_t(uint64_t(a) + uint64_t(b));
+}
+
+inline uint64_t zigzag(int64_t value) {
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+inline void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+inline uint64_t getVarint(const uint8_t*& p) {
+    uint64_t value = *p & 0x7f;
+    int shift = 7;
+    while (*p++ & 0x80) {
+        value |= uint64_t(*p & 0x7f) << shift;
+        shift += 7;
+    }
+    return value;
+}
+
+} // namespace
+
+// PHCCompressedSeries implementation
+PHCCompressedSeries::PHCCompressedSeries(size_t blockRows)
+    : m_blockRows(std::max<size_t>(1, blockRows)) {
+}
+
+void PHCCompressedSeries::reset(size_t numDevices) {
+    m_numDevices = numDevices;
+    m_size = 0;
+    m_blocks.clear();
+    m_prevOffsets.assign(numDevices, 0);
+    m_prevOffsetDeltas.assign(numDevices, 0);
+}
+
+void PHCCompressedSeries::startBlock(uint64_t sequence, int64_t timestamp) {
+    if (!m_blocks.empty()) {
+        m_blocks.back().data.shrink_to_fit();
+    }
+    m_blocks.emplace_back();
+    m_blocks.back().header.firstSequence = sequence;
+    m_blocks.back().header.firstTimestamp = timestamp;
+
+    // Каждый блок начинается с нулевого состояния кодера
+    m_prevSequence = sequence;
+    m_prevTimestamp = 0;
+    m_prevTimestampDelta = 0;
+    std::fill(m_prevOffsets.begin(), m_prevOffsets.end(), 0);
+    std::fill(m_prevOffsetDeltas.begin(), m_prevOffsetDeltas.end(), 0);
+}
+
+void PHCCompressedSeries::append(uint64_t sequence, int64_t timestamp, int64_t lateness,
+                                 const int64_t* offsets, const PHCReading* readings) {
+    if (m_blocks.empty() || m_blocks.back().header.rows >= m_blockRows) {
+        startBlock(sequence, timestamp);
+    }
+    Block& block = m_blocks.back();
+    auto& out = block.data;
+
+    bool valid = true;
+    for (size_t d = 0; d < m_numDevices; ++d) {
+        valid = valid && readings[d].ok();
+    }
+
+    putVarint(out, ((sequence - m_prevSequence) << 1) | (valid ? 0 : 1));
+    m_prevSequence = sequence;
+
+    int64_t delta = wrapSub(timestamp, m_prevTimestamp);
+    putVarint(out, zigzag(wrapSub(delta, m_prevTimestampDelta)));
+    m_prevTimestamp = timestamp;
+    m_prevTimestampDelta = delta;
+
+    putVarint(out, zigzag(lateness));
+
+    for (size_t d = 0; d < m_numDevices; ++d) {
+        delta = wrapSub(offsets[d], m_prevOffsets[d]);
+        putVarint(out, zigzag(wrapSub(delta, m_prevOffsetDeltas[d])));
+        m_prevOffsets[d] = offsets[d];
+        m_prevOffsetDeltas[d] = delta;
+    }
+
+    if (!valid) {
+        for (size_t d = 0; d < m_numDevices; ++d) {
+            putVarint(out, uint64_t(readings[d].error));
+        }
+    }
+
+    block.header.lastTimestamp = timestamp;
+    block.header.rows++;
+    block.header.bytes = out.size();
+    m_size++;
+}
+
+bool PHCCompressedSeries::onSample(const PHCSampleView& sample) {
+    append(sample.sequence, sample.timestamp, sample.lateness, sample.offsets, sample.readings);
+    return true;
+}
+
+size_t PHCCompressedSeries::bytes() const {
+    size_t total = m_blocks.capacity() * sizeof(Block);
+    for (const auto& block : m_blocks) {
+        total += block.data.capacity();
+    }
+    return total;
+}
+
+size_t PHCCompressedSeries::findBlock(int64_t timestamp) const {
+    auto it = std::lower_bound(m_blocks.begin(), m_blocks.end(), timestamp,
+                               [](const Block& block, int64_t t) {
+                                   return block.header.lastTimestamp < t;
+                               });
+    return it - m_blocks.begin();
+}
+
+template <typename Visitor>
+void PHCCompressedSeries::forEachRow(const Block& block, Row& row, Visitor&& visit) const {
+    const uint8_t* p = block.data.data();
+    row.offsets.assign(m_numDevices, 0);
+    row.errors.assign(m_numDevices, 0);
+    std::vector<int64_t> offsetDeltas(m_numDevices, 0);
+
+    uint64_t sequence = block.header.firstSequence;
+    int64_t timestamp = 0;
+    int64_t timestampDelta = 0;
+    for (uint32_t r = 0; r < block.header.rows; ++r) {
+        uint64_t head = getVarint(p);
+        sequence += head >> 1;
+        row.sequence = sequence;
+        row.valid = (head & 1) == 0;
+
+        timestampDelta = wrapAdd(timestampDelta, unzigzag(getVarint(p)));
+        timestamp = wrapAdd(timestamp, timestampDelta);
+        row.timestamp = timestamp;
+        row.lateness = unzigzag(getVarint(p));
+
+        for (size_t d = 0; d < m_numDevices; ++d) {
+            offsetDeltas[d] = wrapAdd(offsetDeltas[d], unzigzag(getVarint(p)));
+            row.offsets[d] = wrapAdd(row.offsets[d], offsetDeltas[d]);
+        }
+
+        if (row.valid) {
+            std::fill(row.errors.begin(), row.errors.end(), 0);
+        } else {
+            for (size_t d = 0; d < m_numDevices; ++d) {
+                row.errors[d] = int(getVarint(p));
+            }
+        }
+        visit(row);
+    }
+}
+
+void PHCCompressedSeries::decodeBlock(size_t index, PHCSeries& out) const {
+    Row row;
+    std::vector<PHCReading> readings(m_numDevices);
+    forEachRow(m_blocks[index], row, [&](const Row& r) {
+        for (size_t d = 0; d < m_numDevices; ++d) {
+            readings[d].offset = r.offsets[d];
+            readings[d].error = r.errors[d];
+        }
+        out.append(r.sequence, r.timestamp, r.lateness, r.offsets.data(), readings.data());
+    });
+}
+
+void PHCCompressedSeries::decode(int64_t from, int64_t to, PHCSeries& out) const {
+    Row row;
+    std::vector<PHCReading> readings(m_numDevices);
+    for (size_t b = findBlock(from); b < m_blocks.size(); ++b) {
+        if (m_blocks[b].header.firstTimestamp > to) {
+            break;
+        }
+        forEachRow(m_blocks[b], row, [&](const Row& r) {
+            if (r.timestamp < from || r.timestamp > to) {
+                return;
+            }
+            for (size_t d = 0; d < m_numDevices; ++d) {
+                readings[d].offset = r.offsets[d];
+                readings[d].error = r.errors[d];
+            }
+            out.append(r.sequence, r.timestamp, r.lateness, r.offsets.data(), readings.data());
+        });
+    }
+}
+
+void PHCCompressedSeries::pairColumn(size_t i, size_t j, std::vector<int64_t>& out) const {
+    out.clear();
+    out.reserve(m_size);
+    Row row;
+    for (const auto& block : m_blocks) {
+        forEachRow(block, row, [&](const Row& r) {
+            if (r.valid) {
+                out.push_back(r.offsets[i] - r.offsets[j]);
+            }
+        });
+    }
+}
+
+void PHCCompressedSeries::latenessColumn(std::vector<int64_t>& out) const {
+    out.clear();
+    out.reserve(m_size);
+    Row row;
+    for (const auto& block : m_blocks) {
+        forEachRow(block, row, [&](const Row& r) {
+            out.push_back(r.lateness);
+        });
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef DIFFPHC_COMPRESSED_H
+#define DIFFPHC_COMPRESSED_H
+
+#include "diffphc_core.h"
+
+// Заголовок блока сжатой истории. Блок декодируется независимо от
+// остальных, поэтому поиск по времени сводится к двоичному поиску по
+// заголовкам и распаковке одного блока.
+struct PHCBlockHeader {
+    uint64_t firstSequence = 0;     // Номер первой итерации блока
+    int64_t firstTimestamp = 0;     // Метка времени первой итерации (нс)
+    int64_t lastTimestamp = 0;      // Метка времени последней итерации (нс)
+    uint32_t rows = 0;              // Итераций в блоке
+    uint32_t bytes = 0;             // Размер закодированных данных
+};
+
+// Сжатая история измерений для длительного мониторинга. Смещения
+// дисциплинированных часов и метки времени на сетке планировщика
+// меняются почти линейно, поэтому хранится вторая разность
+// (delta-of-delta, как в Gorilla) в zigzag varint: типичная итерация
+// занимает 1-2 байта на устройство вместо 8 + sizeof(PHCReading).
+//
+// Строка блока: varint (приращение номера << 1 | признак ошибки),
+// вторые разности метки времени, опоздание, вторые разности смещений
+// устройств; при ошибке чтения - errno каждого устройства. Из
+// PHCReading сохраняется только код ошибки.
+//
+// Подходит как приемник вытеснения кольцевой истории PHCSeries.
+class PHCCompressedSeries : public MeasurementSink {
+public:
+    static constexpr size_t DEFAULT_BLOCK_ROWS = 1024;
+
+    explicit PHCCompressedSeries(size_t blockRows = DEFAULT_BLOCK_ROWS);
+
+    // Очистить и задать число устройств
+    void reset(size_t numDevices);
+    void append(uint64_t sequence, int64_t timestamp, int64_t lateness,
+                const int64_t* offsets, const PHCReading* readings);
+    bool onSample(const PHCSampleView& sample) override;
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_t numDevices() const { return m_numDevices; }
+    size_t blockCount() const { return m_blocks.size(); }
+    const PHCBlockHeader& block(size_t index) const { return m_blocks[index].header; }
+    // Занимаемая память: данные и заголовки блоков
+    size_t bytes() const;
+
+    // Первый блок, который может содержать итерации не раньше timestamp
+    size_t findBlock(int64_t timestamp) const;
+    // Дописать итерации блока в series (число устройств должно совпадать)
+    void decodeBlock(size_t index, PHCSeries& out) const;
+    // Дописать итерации с меткой времени в [from, to]
+    void decode(int64_t from, int64_t to, PHCSeries& out) const;
+
+    // Разности пары (i, j) по всем итерациям без ошибок чтения
+    void pairColumn(size_t i, size_t j, std::vector<int64_t>& out) const;
+    // Опоздания планировщика всех итераций
+    void latenessColumn(std::vector<int64_t>& out) const;
+
+private:
+    // Одна декодированная итерация; offsets и errors - по устройству
+    struct Row {
+        uint64_t sequence = 0;
+        int64_t timestamp = 0;
+        int64_t lateness = 0;
+        bool valid = true;
+        std::vector<int64_t> offsets;
+        std::vector<int> errors;
+    };
+    struct Block {
+        PHCBlockHeader header;
+        std::vector<uint8_t> data;
+    };
+
+    template <typename Visitor>
+    void forEachRow(const Block& block, Row& row, Visitor&& visit) const;
+    void startBlock(uint64_t sequence, int64_t timestamp);
+
+    size_t m_blockRows;
+    size_t m_numDevices = 0;
+    size_t m_size = 0;
+    std::vector<Block> m_blocks;
+
+    // Состояние кодера открытого (последнего) блока
+    uint64_t m_prevSequence = 0;
+    int64_t m_prevTimestamp = 0;
+    int64_t m_prevTimestampDelta = 0;
+    std::vector<int64_t> m_prevOffsets;
+    std::vector<int64_t> m_prevOffsetDeltas;
+};
+
+#endif // DIFFPHC_COMPRESSED_H
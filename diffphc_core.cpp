@@ -1,5 +1,127 @@
 #include "diffphc_core.h"
+#include "diffphc_clock_source.h"
+#include "diffphc_compressed.h"
+#include "diffphc_kernels.h"
+#include <cerrno>
 #include <cmath>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+namespace {
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Сколько итераций спин-барьер ждет остальные потоки чтения, прежде чем
+// заснуть (~0.5-1 мс): разброс пробуждения - десятки мкс, а дольше ждать
+// имеет смысл только если поток делит CPU с другим потоком чтения
+constexpr int BarrierSpinLimit = 1 << 14;
+
+// Динамические POSIX часы: clockid из дескриптора /dev/ptpN
+constexpr int ClockFD = 3;
+
+inline clockid_t fdToClockid(int fd) {
+    return (~(clockid_t)fd << 3) | ClockFD;
+}
+
+inline int64_t clockNow(clockid_t clock) {
+    struct timespec ts = {};
+    clock_gettime(clock, &ts);
+    return ts.tv_nsec + ts.tv_sec * 1000000000LL;
+}
+
+int64_t toNanoseconds(const ptp_clock_time& t) {
+    return t.nsec + 1000'000'000LL * t.sec;
+}
+
+// Квантили PHCStatistics: медиана и процентили
+constexpr size_t STATISTICS_QUANTILE_COUNT = 6;
+constexpr double STATISTICS_QUANTILES[STATISTICS_QUANTILE_COUNT] = {0.5, 0.01, 0.05, 0.95, 0.99, 0.999};
+
+void setQuantiles(PHCStatistics& stats, const double* quantiles) {
+    stats.median = quantiles[0];
+    stats.p1 = quantiles[1];
+    stats.p5 = quantiles[2];
+    stats.p95 = quantiles[3];
+    stats.p99 = quantiles[4];
+    stats.p999 = quantiles[5];
+}
+
+// Сводка потоковой статистики с медианой и процентилями из эскиза
+PHCStatistics sketchStatistics(const PHCRunningStats& running, const PHCQuantileSketch& sketch) {
+    PHCStatistics stats = running.statistics();
+    if (sketch.empty()) {
+        return stats;
+    }
+    double quantiles[STATISTICS_QUANTILE_COUNT];
+    for (size_t k = 0; k < STATISTICS_QUANTILE_COUNT; ++k) {
+        quantiles[k] = sketch.quantile(STATISTICS_QUANTILES[k]);
+    }
+    setQuantiles(stats, quantiles);
+    return stats;
+}
+
+} // namespace
+
+// Оценка смещения PHC относительно системного времени по набору
+// отсчетов t0 (система) - t1 (PHC) - t2 (система). Отсчеты с задержкой
+// больше минимальной на PHCCallMaxDelay отбрасываются.
+void DiffPHCCore::estimateOffset(const int64_t* t0, const int64_t* t1, const int64_t* t2,
+                                 int samples, PHCReading& reading) {
+    int64_t delay[PTP_MAX_SAMPLES];
+    int64_t mindelay = INT64_MAX;
+    for (int i = 0; i < samples; ++i) {
+        delay[i] = t2[i] - t0[i];
+        // Отсчеты с обратным ходом системных часов отбрасываются ниже и не
+        // должны задавать минимум
+        if (delay[i] >= 0 && mindelay > delay[i]) {
+            mindelay = delay[i];
+        }
+    }
+    
+    int count = 0;
+    int64_t phcTotal = 0;
+    int64_t sysTotal = 0;
+    int64_t sysTime = 0;
+    int64_t phcTime = 0;
+
+    double delayTotal = 0.0;
+    int64_t acceptedMinDelay = 0;
+    for (int i = 0; i < samples; ++i) {
+        if (t2[i] < t0[i] || delay[i] > mindelay + PHCCallMaxDelay) {
+            continue;
+        }
+        count++;
+        if (count == 1) {
+            sysTime = t0[i];
+            phcTime = t1[i];
+            acceptedMinDelay = delay[i];
+        }
+        sysTotal += t0[i] - sysTime;
+        phcTotal += t1[i] - phcTime;
+        delayTotal += delay[i] / 2.0;
+        acceptedMinDelay = std::min(acceptedMinDelay, delay[i]);
+    }
+
+    reading.samples = samples;
+    reading.accepted = count;
+    if (!count) {
+        reading.error = ENODATA;
+        return;
+    }
+
+    sysTime += (sysTotal + count / 2) / count + int64_t(delayTotal / count);
+    phcTime += (phcTotal + count / 2) / count;
+    reading.offset = phcTime - sysTime;
+    reading.minDelay = acceptedMinDelay;
+    reading.meanDelay = int64_t(2.0 * delayTotal / count);
+}
 
 std::string DiffPHCCore::getPHCFileName(int phc_index) {
     std::stringstream s;
@@ -37,18 +159,26 @@ bool DiffPHCCore::printClockInfo(int phc_index) {
                   << std::endl;
     }
 
-    struct ptp_sys_offset_extended sys_off_ext = {};
-    sys_off_ext.n_samples = 1;
-    bool supportOffsetExtended =
-        !ioctl(phc_fd, PTP_SYS_OFFSET_EXTENDED, &sys_off_ext);
+    bool supportOffsetPrecise = supportsReadMethod(phc_fd, PHCReadMethod::Precise);
+    bool supportOffsetExtended = supportsReadMethod(phc_fd, PHCReadMethod::Extended);
+    bool supportOffsetBasic = supportsReadMethod(phc_fd, PHCReadMethod::Basic);
+    bool supportDirect = supportsReadMethod(phc_fd, PHCReadMethod::Direct);
 
     std::cout << caps.max_adj
               << " maximum frequency adjustment in parts per billon.\n"
               << caps.n_ext_ts << " external time stamp channels.\n"
               << "PPS callback: " << (caps.pps ? "TRUE" : "FALSE") << "\n"
               << caps.n_pins << " input/output pins.\n"
+              << "PTP_SYS_OFFSET_PRECISE support: "
+              << (supportOffsetPrecise ? "TRUE" : "FALSE") << "\n"
               << "PTP_SYS_OFFSET_EXTENDED support: "
               << (supportOffsetExtended ? "TRUE" : "FALSE") << "\n"
+              << "PTP_SYS_OFFSET support: "
+              << (supportOffsetBasic ? "TRUE" : "FALSE") << "\n"
+              << "clock_gettime(FD_TO_CLOCKID) support: "
+              << (supportDirect ? "TRUE" : "FALSE") << "\n"
+              << "Selected read method: "
+              << readMethodName(probeReadMethod(phc_fd)) << "\n"
               << std::endl;
     close(phc_fd);
     return true;
@@ -78,6 +208,44 @@ std::vector<int> DiffPHCCore::getAvailablePHCDevices() {
 }
 
 bool DiffPHCCore::validateConfig(const PHCConfig& config, std::string& error) {
+    if (!validateParameters(config, error)) {
+        return false;
+    }
+    
+    // Check if devices exist and are accessible
+    if (config.simulate) {
+        return true;
+    }
+    for (auto d : config.devices) {
+        auto name = getPHCFileName(d);
+        int fd = openPHC(name);
+        if (fd < 0) {
+            error = "PTP device " + name + " not found or not accessible";
+            return false;
+        }
+        close(fd);
+    }
+    
+    return true;
+}
+
+size_t DiffPHCCore::historyLimit(const PHCConfig& config) {
+    size_t rows = config.historySize;
+    if (config.historyMemory > 0) {
+        size_t fit = PHCSeries::rowsForMemory(config.historyMemory, config.devices.size());
+        rows = rows ? std::min(rows, fit) : fit;
+    }
+    if (rows == 0 && config.count == 0) {
+        rows = PHC_DEFAULT_HISTORY;
+    }
+    // Ограниченное число итераций, умещающееся в лимит, хранится целиком
+    if (config.count > 0 && rows >= size_t(config.count)) {
+        return 0;
+    }
+    return rows;
+}
+
+bool DiffPHCCore::validateParameters(const PHCConfig& config, std::string& error) {
     // Validate count parameter
     if (config.count < 0) {
         error = "Invalid count parameter: must be >= 0 (0 = infinite)";
@@ -117,20 +285,43 @@ bool DiffPHCCore::validateConfig(const PHCConfig& config, std::string& error) {
         return false;
     }
     
-    // Check if devices exist and are accessible
     for (auto d : config.devices) {
         if (d < 0) {
             error = "Invalid device number: " + std::to_string(d) + " (must be >= 0)";
             return false;
         }
-        
-        auto name = getPHCFileName(d);
-        int fd = openPHC(name);
-        if (fd < 0) {
-            error = "PTP device " + name + " not found or not accessible";
+    }
+    
+    for (auto cpu : config.cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            error = "Invalid CPU number: " + std::to_string(cpu);
+            return false;
+        }
+    }
+    
+    if (config.historyMemory > 0 &&
+        PHCSeries::rowsForMemory(config.historyMemory, config.devices.size()) == 0) {
+        error = "Invalid history memory: less than one measurement row";
+        return false;
+    }
+    
+    if (config.adaptiveSamples && config.targetUncertainty < 1) {
+        error = "Invalid target uncertainty: must be >= 1 ns";
+        return false;
+    }
+    
+    if (config.realtime) {
+        int minPriority = sched_get_priority_min(SCHED_FIFO);
+        int maxPriority = sched_get_priority_max(SCHED_FIFO);
+        if (config.rtPriority < minPriority || config.rtPriority > maxPriority) {
+            error = "Invalid realtime priority: must be " + std::to_string(minPriority) +
+                    ".." + std::to_string(maxPriority);
+            return false;
+        }
+        if (config.rtCpu >= CPU_SETSIZE) {
+            error = "Invalid CPU number: " + std::to_string(config.rtCpu);
             return false;
         }
-        close(fd);
     }
     
     return true;
@@ -154,198 +345,320 @@ bool DiffPHCCore::checkPTPDevicesAvailable(std::string& error) {
 }
 
 PHCResult DiffPHCCore::measurePHCDifferences(const PHCConfig& config) {
-    PHCResult result;
-    result.success = false;
-    result.devices = config.devices;
-    
+    PHCSession session;
     std::string error;
-    if (!validateConfig(config, error)) {
+    if (!session.open(config, error)) {
+        PHCResult result;
+        result.success = false;
+        result.devices = config.devices;
         result.error = error;
         return result;
     }
-    
-    if (requiresRoot()) {
-        result.error = "Root privileges required";
-        return result;
-    }
-    
-    std::vector<int> dev;
-    for (auto d : config.devices) {
-        auto name = getPHCFileName(d);
-        int fd = openPHC(name);
-        if (fd < 1) {
-            result.error = "PTP device " + name + " open failed";
-            return result;
-        }
-        dev.push_back(fd);
-    }
+    return session.run();
+}
 
-    const int numDev = dev.size();
-    std::vector<int64_t> ts(numDev);
-    
-    for (int c = 0; config.count == 0 || c < config.count; ++c) {
-        int64_t baseTimestamp = getCPUNow();
-        for (int d = 0; d < numDev; ++d) {
-            int64_t now = getCPUNow();
-            ts[d] = getPTPSysOffsetExtended(dev[d], config.samples) - (now - baseTimestamp);
-        }
-        
-        std::vector<int64_t> differences;
-        for (int i = 0; i < numDev; ++i) {
-            for (int j = 0; j <= i; ++j) {
-                differences.push_back(long(ts[i]) - long(ts[j]));
-            }
-        }
-        
-        result.differences.push_back(differences);
-        result.baseTimestamp = baseTimestamp;
-        
-        if (config.count != 0 && c == config.count - 1) break;
-        usleep(config.delay);
+PHCReading DiffPHCCore::getPTPSysOffsetExtended(int clkPTPid, int samples) {
+    int64_t t0[PTP_MAX_SAMPLES];
+    int64_t t1[PTP_MAX_SAMPLES];
+    int64_t t2[PTP_MAX_SAMPLES];
+
+    samples = std::min(PTP_MAX_SAMPLES, samples);
+
+    PHCReading reading;
+    reading.samples = samples;
+    struct ptp_sys_offset_extended sys_off = {};
+    sys_off.n_samples = samples;
+    int64_t start = clockNow(CLOCK_MONOTONIC_RAW);
+    int rc = ioctl(clkPTPid, PTP_SYS_OFFSET_EXTENDED, &sys_off);
+    reading.callNs = clockNow(CLOCK_MONOTONIC_RAW) - start;
+    if (rc) {
+        reading.error = errno;
+        return reading;
     }
-    
-    for (auto fd : dev) {
-        close(fd);
+
+    for (int i = 0; i < samples; ++i) {
+        t0[i] = toNanoseconds(sys_off.ts[i][0]);
+        t1[i] = toNanoseconds(sys_off.ts[i][1]);
+        t2[i] = toNanoseconds(sys_off.ts[i][2]);
     }
     
-    result.success = true;
-    
-    // Рассчитать статистику, если есть измерения
-    if (!result.differences.empty()) {
-        calculateResultStatistics(result);
+    estimateOffset(t0, t1, t2, samples, reading);
+    return reading;
+}
+
+PHCReading DiffPHCCore::getPTPSysOffsetPrecise(int clkPTPid) {
+    PHCReading reading;
+    reading.samples = 1;
+    struct ptp_sys_offset_precise sys_off = {};
+    int64_t start = clockNow(CLOCK_MONOTONIC_RAW);
+    int rc = ioctl(clkPTPid, PTP_SYS_OFFSET_PRECISE, &sys_off);
+    reading.callNs = clockNow(CLOCK_MONOTONIC_RAW) - start;
+    if (rc) {
+        reading.error = errno;
+        return reading;
     }
     
-    return result;
+    // Аппаратный cross-timestamp: PHC и системное время сняты в один момент
+    reading.accepted = 1;
+    reading.offset = toNanoseconds(sys_off.device) - toNanoseconds(sys_off.sys_realtime);
+    return reading;
 }
 
-int64_t DiffPHCCore::getPTPSysOffsetExtended(int clkPTPid, int samples) {
+PHCReading DiffPHCCore::getPTPSysOffsetBasic(int clkPTPid, int samples) {
     int64_t t0[PTP_MAX_SAMPLES];
     int64_t t1[PTP_MAX_SAMPLES];
     int64_t t2[PTP_MAX_SAMPLES];
-    int64_t delay[PTP_MAX_SAMPLES];
 
     samples = std::min(PTP_MAX_SAMPLES, samples);
 
-    struct ptp_sys_offset_extended sys_off = {};
+    PHCReading reading;
+    reading.samples = samples;
+    struct ptp_sys_offset sys_off = {};
     sys_off.n_samples = samples;
-    if (ioctl(clkPTPid, PTP_SYS_OFFSET_EXTENDED, &sys_off)) {
-        std::cerr << "ERR: ioctl(PTP_SYS_OFFSET_EXTENDED) failed : "
-                  << strerror(errno) << std::endl;
-        return 0;
+    int64_t start = clockNow(CLOCK_MONOTONIC_RAW);
+    int rc = ioctl(clkPTPid, PTP_SYS_OFFSET, &sys_off);
+    reading.callNs = clockNow(CLOCK_MONOTONIC_RAW) - start;
+    if (rc) {
+        reading.error = errno;
+        return reading;
     }
 
-    int64_t mindelay = uint64_t(-1);
+    // Отметки чередуются: система, PHC, система, ..., система
     for (int i = 0; i < samples; ++i) {
-        t0[i] = sys_off.ts[i][0].nsec + 1000'000'000ULL * sys_off.ts[i][0].sec;
-        t1[i] = sys_off.ts[i][1].nsec + 1000'000'000ULL * sys_off.ts[i][1].sec;
-        t2[i] = sys_off.ts[i][2].nsec + 1000'000'000ULL * sys_off.ts[i][2].sec;
-        delay[i] = t2[i] - t0[i];
-        if (mindelay > delay[i]) {
-            mindelay = delay[i];
-        }
+        t0[i] = toNanoseconds(sys_off.ts[2 * i]);
+        t1[i] = toNanoseconds(sys_off.ts[2 * i + 1]);
+        t2[i] = toNanoseconds(sys_off.ts[2 * i + 2]);
     }
     
-    int count = 0;
-    int64_t phcTotal = 0;
-    int64_t sysTotal = 0;
-    int64_t sysTime = 0;
-    int64_t phcTime = 0;
+    estimateOffset(t0, t1, t2, samples, reading);
+    return reading;
+}
 
-    double delayTotal = 0.0;
+PHCReading DiffPHCCore::getPHCDirect(int clkPTPid, int samples) {
+    const clockid_t phcClock = fdToClockid(clkPTPid);
+    samples = std::max(1, std::min(PTP_MAX_SAMPLES, samples));
+    
+    PHCReading reading;
+    reading.samples = samples;
+    
+    // Из нескольких попыток берется самое узкое окно MONOTONIC_RAW,
+    // без усреднения: только одно сравнение на попытку
+    int64_t delay[PTP_MAX_SAMPLES];
+    int64_t bestDelay = INT64_MAX;
+    int64_t bestOffset = 0;
+    int64_t start = clockNow(CLOCK_MONOTONIC_RAW);
     for (int i = 0; i < samples; ++i) {
-        if (t2[i] < t0[i] || delay[i] > mindelay + PHCCallMaxDelay) {
-            continue;
+        struct timespec phc = {};
+        int64_t t0 = clockNow(CLOCK_MONOTONIC_RAW);
+        int rc = clock_gettime(phcClock, &phc);
+        int64_t t2 = clockNow(CLOCK_MONOTONIC_RAW);
+        if (rc) {
+            reading.error = errno;
+            reading.callNs = t2 - start;
+            return reading;
         }
-        count++;
-        if (count == 1) {
-            sysTime = t0[i];
-            phcTime = t1[i];
+        delay[i] = t2 - t0;
+        if (t2 - t0 < bestDelay) {
+            bestDelay = t2 - t0;
+            bestOffset = phc.tv_nsec + phc.tv_sec * 1000000000LL - (t0 + (t2 - t0) / 2);
+        }
+    }
+    reading.callNs = clockNow(CLOCK_MONOTONIC_RAW) - start;
+    
+    // Критерий отбраковки тот же, что и для ioctl способов
+    int64_t delayTotal = 0;
+    for (int i = 0; i < samples; ++i) {
+        if (delay[i] <= bestDelay + PHCCallMaxDelay) {
+            reading.accepted++;
+            delayTotal += delay[i];
         }
-        sysTotal += t0[i] - sysTime;
-        phcTotal += t1[i] - phcTime;
-        delayTotal += delay[i] / 2.0;
     }
+    reading.minDelay = bestDelay;
+    reading.meanDelay = delayTotal / reading.accepted;
+    
+    // Перевод смещения из MONOTONIC_RAW в ось CLOCK_REALTIME, общую для
+    // всех способов чтения
+    int64_t m0 = clockNow(CLOCK_MONOTONIC_RAW);
+    int64_t realtime = getCPUNow();
+    int64_t m1 = clockNow(CLOCK_MONOTONIC_RAW);
+    int64_t rawToRealtime = realtime - (m0 + (m1 - m0) / 2);
+    
+    reading.offset = bestOffset - rawToRealtime;
+    return reading;
+}
 
-    if (!count) {
-        return 0;
+PHCReading DiffPHCCore::readPHC(int clkPTPid, PHCReadMethod method, int samples) {
+    switch (method) {
+        case PHCReadMethod::Precise:
+            return getPTPSysOffsetPrecise(clkPTPid);
+        case PHCReadMethod::Basic:
+            return getPTPSysOffsetBasic(clkPTPid, samples);
+        case PHCReadMethod::Direct:
+            return getPHCDirect(clkPTPid, samples);
+        case PHCReadMethod::Extended:
+        default:
+            return getPTPSysOffsetExtended(clkPTPid, samples);
     }
+}
 
-    sysTime += (sysTotal + count / 2) / count + int64_t(delayTotal / count);
-    phcTime += (phcTotal + count / 2) / count;
+bool DiffPHCCore::supportsReadMethod(int clkPTPid, PHCReadMethod method) {
+    switch (method) {
+        case PHCReadMethod::Precise: {
+            struct ptp_sys_offset_precise sys_off = {};
+            return !ioctl(clkPTPid, PTP_SYS_OFFSET_PRECISE, &sys_off);
+        }
+        case PHCReadMethod::Extended: {
+            struct ptp_sys_offset_extended sys_off = {};
+            sys_off.n_samples = 1;
+            return !ioctl(clkPTPid, PTP_SYS_OFFSET_EXTENDED, &sys_off);
+        }
+        case PHCReadMethod::Basic: {
+            struct ptp_sys_offset sys_off = {};
+            sys_off.n_samples = 1;
+            return !ioctl(clkPTPid, PTP_SYS_OFFSET, &sys_off);
+        }
+        case PHCReadMethod::Direct: {
+            struct timespec ts = {};
+            return !clock_gettime(fdToClockid(clkPTPid), &ts);
+        }
+        default:
+            return false;
+    }
+}
 
-    return getCPUNow() + phcTime - sysTime;
+PHCReadMethod DiffPHCCore::probeReadMethod(int clkPTPid) {
+    // Порядок предпочтения: наименьшая ошибка измерения первой
+    for (auto method : {PHCReadMethod::Precise, PHCReadMethod::Extended, PHCReadMethod::Basic}) {
+        if (supportsReadMethod(clkPTPid, method)) {
+            return method;
+        }
+    }
+    return PHCReadMethod::None;
 }
 
-// Statistical analysis functions
-double DiffPHCCore::calculateMedian(std::vector<int64_t> values) {
-    if (values.empty()) return 0.0;
-    
-    std::sort(values.begin(), values.end());
-    size_t n = values.size();
-    
-    if (n % 2 == 0) {
-        return (values[n/2 - 1] + values[n/2]) / 2.0;
-    } else {
-        return values[n/2];
+const char* DiffPHCCore::readMethodName(PHCReadMethod method) {
+    switch (method) {
+        case PHCReadMethod::Auto:     return "auto";
+        case PHCReadMethod::Precise:  return "precise";
+        case PHCReadMethod::Extended: return "extended";
+        case PHCReadMethod::Basic:    return "basic";
+        case PHCReadMethod::Direct:   return "direct";
+        default:                      return "none";
+    }
+}
+
+bool DiffPHCCore::parseReadMethod(const std::string& name, PHCReadMethod& method) {
+    for (auto m : {PHCReadMethod::Auto, PHCReadMethod::Precise, PHCReadMethod::Extended,
+                   PHCReadMethod::Basic, PHCReadMethod::Direct}) {
+        if (name == readMethodName(m)) {
+            method = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<PHCReadBenchmark> DiffPHCCore::benchmarkReadMethods(int phc_index, int iterations, int samples) {
+    PHCHardwareSource source;
+    std::string error;
+    if (!source.open(phc_index, error)) {
+        return {};
+    }
+    return benchmarkReadMethods(source, iterations, samples);
+}
+
+std::vector<PHCReadBenchmark> DiffPHCCore::benchmarkReadMethods(PHCClockSource& source, int iterations, int samples) {
+    std::vector<PHCReadBenchmark> results;
+    for (auto method : {PHCReadMethod::Precise, PHCReadMethod::Extended,
+                        PHCReadMethod::Basic, PHCReadMethod::Direct}) {
+        PHCReadBenchmark bench = {};
+        bench.method = method;
+        bench.supported = source.supportsReadMethod(method);
+        if (!bench.supported) {
+            results.push_back(bench);
+            continue;
+        }
+        
+        std::vector<int64_t> callNs;
+        std::vector<int64_t> offsets;
+        callNs.reserve(iterations);
+        offsets.reserve(iterations);
+        for (int i = 0; i < iterations; ++i) {
+            auto reading = source.read(method, samples);
+            if (!reading.ok()) {
+                continue;
+            }
+            callNs.push_back(reading.callNs);
+            offsets.push_back(reading.offset);
+        }
+        
+        auto callStats = calculateStatistics(callNs);
+        bench.iterations = callStats.count;
+        bench.meanCallNs = callStats.mean;
+        bench.minCallNs = callStats.minimum;
+        bench.medianCallNs = callStats.median;
+        bench.offsetStdDev = calculateStdDev(offsets, calculateMean(offsets));
+        results.push_back(bench);
     }
+    
+    return results;
+}
+
+// Statistical analysis functions
+double DiffPHCCore::calculateMedian(const std::vector<int64_t>& values) {
+    return PHCQuantileSelector().median(values);
 }
 
 double DiffPHCCore::calculateMean(const std::vector<int64_t>& values) {
     if (values.empty()) return 0.0;
     
-    int64_t sum = 0;
-    for (auto value : values) {
-        sum += value;
-    }
-    return static_cast<double>(sum) / values.size();
+    // Относительно первого значения: сумма абсолютных меток переполнила бы int64
+    const int64_t ref = values.front();
+    return ref + PHCKernels::sum(values.data(), values.size(), ref) / values.size();
 }
 
 double DiffPHCCore::calculateStdDev(const std::vector<int64_t>& values, double mean) {
     if (values.size() <= 1) return 0.0;
     
-    double variance = 0.0;
-    for (auto value : values) {
-        double diff = value - mean;
-        variance += diff * diff;
-    }
+    const int64_t ref = values.front();
+    double variance = PHCKernels::sumSquares(values.data(), values.size(), ref, mean - ref);
     variance /= (values.size() - 1);
     return std::sqrt(variance);
 }
 
 PHCStatistics DiffPHCCore::calculateStatistics(const std::vector<int64_t>& values) {
-    PHCStatistics stats = {};
-    
-    if (values.empty()) {
-        stats.count = 0;
-        return stats;
+    std::vector<int64_t> scratch = values;
+    PHCQuantileSelector selector;
+    return calculateStatisticsInPlace(scratch, selector);
+}
+
+PHCStatistics DiffPHCCore::calculateStatisticsInPlace(std::vector<int64_t>& values, PHCQuantileSelector& selector) {
+    // min/max, среднее и СКО - векторными ядрами (три прохода по памяти
+    // быстрее одного скалярного прохода Уэлфорда); медиана и процентили -
+    // одним выбором
+    PHCRunningStats running;
+    if (!values.empty()) {
+        const int64_t ref = values.front();
+        const double offset = PHCKernels::sum(values.data(), values.size(), ref) / values.size();
+        running.count = values.size();
+        PHCKernels::minmax(values.data(), values.size(), running.minimum, running.maximum);
+        running.mean = ref + offset;
+        running.m2 = PHCKernels::sumSquares(values.data(), values.size(), ref, offset);
     }
+    PHCStatistics stats = running.statistics();
     
-    stats.count = values.size();
-    
-    // Найти минимум и максимум
-    auto minmax = std::minmax_element(values.begin(), values.end());
-    stats.minimum = *minmax.first;
-    stats.maximum = *minmax.second;
-    stats.range = stats.maximum - stats.minimum;
-    
-    // Рассчитать среднее
-    stats.mean = calculateMean(values);
-    
-    // Рассчитать медиану
-    stats.median = calculateMedian(values);
-    
-    // Рассчитать стандартное отклонение
-    stats.stddev = calculateStdDev(values, stats.mean);
-    
+    double quantiles[STATISTICS_QUANTILE_COUNT];
+    selector.selectInPlace(values.data(), values.size(), STATISTICS_QUANTILES, STATISTICS_QUANTILE_COUNT, quantiles);
+    setQuantiles(stats, quantiles);
     return stats;
 }
 
-void DiffPHCCore::calculateResultStatistics(PHCResult& result) {
-    if (!result.success || result.differences.empty()) {
+void DiffPHCCore::calculateResultStatistics(PHCResult& result, const PHCCompressedSeries* archive) {
+    if (!result.success || result.series.empty()) {
         return;
     }
     
-    const int numDev = result.devices.size();
+    const int numDev = result.series.numDevices();
     
     // Инициализировать массив статистики
     result.statistics.resize(numDev);
@@ -353,26 +666,850 @@ void DiffPHCCore::calculateResultStatistics(PHCResult& result) {
         result.statistics[i].resize(i + 1);
     }
     
-    // Собрать данные для каждой пары устройств
-    std::vector<std::vector<std::vector<int64_t>>> pairData(numDev);
-    for (int i = 0; i < numDev; ++i) {
-        pairData[i].resize(i + 1);
-    }
-    
-    // Заполнить данные из всех измерений
-    for (const auto& measurement : result.differences) {
-        int idx = 0;
+    // Часть итераций вытеснена из кольца без архива: столбцов для точной
+    // статистики нет, сводка берется из потоковой статистики всего измерения
+    const size_t stored = result.series.size() + (archive ? archive->size() : 0);
+    const auto& running = result.running;
+    if (!running.empty() && (int)running.numDevices == numDev && stored < running.lateness.count) {
+        result.scheduling = running.latenessStatistics();
         for (int i = 0; i < numDev; ++i) {
             for (int j = 0; j <= i; ++j) {
-                pairData[i][j].push_back(measurement[idx++]);
+                result.statistics[i][j] = running.pairStatistics(i, j);
             }
         }
+        return;
     }
     
-    // Рассчитать статистику для каждой пары
+    // Столбец по архиву и хранящимся в памяти итерациям
+    std::vector<int64_t> tail;
+    auto column = [&](std::vector<int64_t>& out, auto&& archived, auto&& recent) {
+        if (archive && !archive->empty()) {
+            archived(out);
+            recent(tail);
+            out.insert(out.end(), tail.begin(), tail.end());
+        } else {
+            recent(out);
+        }
+    };
+    
+    PHCQuantileSelector selector;
+    std::vector<int64_t> lateness;
+    column(lateness,
+           [&](std::vector<int64_t>& out) { archive->latenessColumn(out); },
+           [&](std::vector<int64_t>& out) { result.series.latenessColumn(out); });
+    result.scheduling = calculateStatisticsInPlace(lateness, selector);
+    
+    // Рассчитать статистику для каждой пары по двум столбцам смещений.
+    // Итерации, в которых хотя бы одно устройство не прочитано, в
+    // статистику не попадают.
+    std::vector<int64_t> pairData;
+    pairData.reserve(stored);
     for (int i = 0; i < numDev; ++i) {
         for (int j = 0; j <= i; ++j) {
-            result.statistics[i][j] = calculateStatistics(pairData[i][j]);
+            column(pairData,
+                   [&](std::vector<int64_t>& out) { archive->pairColumn(i, j, out); },
+                   [&](std::vector<int64_t>& out) { result.series.pairColumn(i, j, out); });
+            result.statistics[i][j] = calculateStatisticsInPlace(pairData, selector);
+        }
+    }
+}
+
+// PHCRunningStats implementation
+void PHCRunningStats::merge(const PHCRunningStats& other) {
+    if (other.count == 0) {
+        return;
+    }
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    minimum = std::min(minimum, other.minimum);
+    maximum = std::max(maximum, other.maximum);
+    double total = double(count + other.count);
+    double delta = other.mean - mean;
+    mean += delta * other.count / total;
+    m2 += other.m2 + delta * delta * count * other.count / total;
+    count += other.count;
+}
+
+PHCStatistics PHCRunningStats::statistics() const {
+    PHCStatistics stats = {};
+    stats.count = count;
+    if (count == 0) {
+        return stats;
+    }
+    stats.minimum = minimum;
+    stats.maximum = maximum;
+    stats.range = range();
+    stats.mean = mean;
+    stats.stddev = stddev();
+    return stats;
+}
+
+// PHCRunningSummary implementation
+PHCStatistics PHCRunningSummary::pairStatistics(size_t i, size_t j) const {
+    const size_t index = PHCPairView::index(i, j);
+    return sketchStatistics(pairs[index], quantiles[index]);
+}
+
+PHCStatistics PHCRunningSummary::latenessStatistics() const {
+    return sketchStatistics(lateness, latenessQuantiles);
+}
+
+// PHCSession implementation
+PHCSession::~PHCSession() {
+    close();
+}
+
+bool PHCSession::open(const PHCConfig& config, std::string& error) {
+    close();
+    
+    if (!DiffPHCCore::validateParameters(config, error)) {
+        return false;
+    }
+    
+    if (!config.simulate && DiffPHCCore::requiresRoot()) {
+        error = "Root privileges required";
+        return false;
+    }
+    
+    for (auto d : config.devices) {
+        auto source = PHCClockSource::open(d, config, error);
+        if (!source) {
+            close();
+            return false;
+        }
+        const auto name = source->name();
+        m_caps.push_back(source->capabilities());
+        
+        // Способ чтения определяется один раз при открытии
+        PHCReadMethod method = config.method;
+        auto forced = config.deviceMethods.find(d);
+        if (forced != config.deviceMethods.end()) {
+            method = forced->second;
+        }
+        if (method == PHCReadMethod::Auto) {
+            method = source->probeReadMethod();
+            if (method == PHCReadMethod::None) {
+                error = "PTP device " + name + " supports no PTP_SYS_OFFSET* ioctl";
+                close();
+                return false;
+            }
+        } else if (!source->supportsReadMethod(method)) {
+            error = "PTP device " + name + " does not support read method '" +
+                    DiffPHCCore::readMethodName(method) + "'";
+            close();
+            return false;
+        }
+        m_methods.push_back(method);
+        m_sources.push_back(std::move(source));
+    }
+    
+    m_config = config;
+    m_offsets.assign(m_sources.size(), 0);
+    m_readings.assign(m_sources.size(), PHCReading());
+    m_readStats.assign(m_sources.size(), PHCDeviceReadStats());
+    m_adaptive.assign(m_sources.size(), PHCAdaptiveSamples());
+    for (auto& adaptive : m_adaptive) {
+        adaptive.reset(m_config.samples, m_config.targetUncertainty);
+    }
+    m_sequence = 0;
+    m_running.reset(m_sources.size());
+    
+    if (m_config.parallel && m_sources.size() > 1 && !startReaders(error)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void PHCSession::close() {
+    stopReaders();
+    m_sources.clear();
+    m_caps.clear();
+    m_methods.clear();
+    m_offsets.clear();
+    m_readings.clear();
+    m_readStats.clear();
+    m_adaptive.clear();
+}
+
+bool PHCSession::sampleOnce(PHCResult& result, int64_t lateness) {
+    if (!isOpen()) {
+        return false;
+    }
+    
+    acquire(lateness);
+    accountReadings(result);
+    
+    if (result.series.numDevices() != m_sources.size()) {
+        result.series.reset(m_sources.size());
+    }
+    result.series.append(m_sequence - 1, m_baseTimestamp, lateness, m_offsets.data(), m_readings.data());
+    result.baseTimestamp = m_baseTimestamp;
+    return true;
+}
+
+bool PHCSession::sampleLatest(PHCResult& result, int64_t lateness) {
+    if (!isOpen()) {
+        return false;
+    }
+    
+    acquire(lateness);
+    accountReadings(result);
+    
+    if (result.series.numDevices() != m_sources.size()) {
+        result.series.reset(m_sources.size());
+    }
+    result.series.clear();
+    result.series.append(m_sequence - 1, m_baseTimestamp, lateness, m_offsets.data(), m_readings.data());
+    result.baseTimestamp = m_baseTimestamp;
+    return true;
+}
+
+bool PHCSession::acquire(int64_t lateness) {
+    const int numDev = m_sources.size();
+    if (m_readers.empty()) {
+        sampleSequential();
+    } else {
+        sampleParallel();
+    }
+    
+    bool valid = true;
+    for (int d = 0; d < numDev; ++d) {
+        m_readStats[d].add(m_readings[d]);
+        valid = valid && m_readings[d].ok();
+    }
+    m_running.add(lateness, PHCPairView(m_offsets.data(), numDev), valid);
+    m_sequence++;
+    return valid;
+}
+
+void PHCSession::accountReadings(PHCResult& result) const {
+    for (const auto& r : m_readings) {
+        result.samplesRead += r.samples;
+        result.samplesRejected += r.samples - r.accepted;
+    }
+    result.readStats.assign(m_readStats.begin(), m_readStats.end());
+}
+
+void PHCSession::sampleSequential() {
+    const int numDev = m_sources.size();
+    m_baseTimestamp = DiffPHCCore::getCPUNow();
+    for (int d = 0; d < numDev; ++d) {
+        readDevice(d);
+    }
+}
+
+void PHCSession::readDevice(int d) {
+    const bool adaptive = m_config.adaptiveSamples && m_methods[d] != PHCReadMethod::Precise;
+    const int samples = adaptive ? m_adaptive[d].samples() : m_config.samples;
+    
+    m_readings[d] = m_sources[d]->read(m_methods[d], samples);
+    m_offsets[d] = m_readings[d].offset;
+    
+    if (adaptive) {
+        m_adaptive[d].update(m_readings[d]);
+    }
+}
+
+std::vector<int> PHCSession::deviceSamples() const {
+    std::vector<int> samples;
+    for (size_t d = 0; d < m_sources.size(); ++d) {
+        if (m_methods[d] == PHCReadMethod::Precise) {
+            samples.push_back(1);
+        } else {
+            samples.push_back(m_config.adaptiveSamples ? m_adaptive[d].samples() : m_config.samples);
+        }
+    }
+    return samples;
+}
+
+void PHCSession::sampleParallel() {
+    const int numDev = m_sources.size();
+    // Все потоки уже прошли барьер прошлой итерации, счетчики можно сбросить
+    m_arrived.store(0, std::memory_order_relaxed);
+    m_finished.store(0, std::memory_order_relaxed);
+    m_baseTimestamp = DiffPHCCore::getCPUNow();
+    {
+        std::lock_guard<std::mutex> lock(m_readerMutex);
+        ++m_generation;
+    }
+    m_readerCv.notify_all();
+    
+    while (m_finished.load(std::memory_order_acquire) < numDev) {
+        std::this_thread::yield();
+    }
+}
+
+bool PHCSession::startReaders(std::string& error) {
+    m_readersStop = false;
+    m_generation = 0;
+    
+    const int numDev = m_sources.size();
+    const int numCpus = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    std::vector<int> cpus(numDev);
+    for (int d = 0; d < numDev; ++d) {
+        cpus[d] = m_config.cpus.empty() ? d % numCpus
+                                        : m_config.cpus[d % m_config.cpus.size()];
+    }
+    // Потоки SCHED_FIFO одного приоритета на одном CPU не вытесняют друг
+    // друга: каждому потоку чтения нужен свой CPU
+    if (m_config.realtime) {
+        for (int d = 0; d < numDev; ++d) {
+            for (int e = 0; e < d; ++e) {
+                if (cpus[d] == cpus[e]) {
+                    error = "Realtime parallel mode needs a separate CPU for each of " +
+                            std::to_string(numDev) + " PHC reader threads, CPU " +
+                            std::to_string(cpus[d]) + " is assigned twice" +
+                            (m_config.cpus.empty() ? "" : " (check --cpus)");
+                    return false;
+                }
+            }
+        }
+    }
+    
+    for (int d = 0; d < numDev; ++d) {
+        m_readers.emplace_back(&PHCSession::readerLoop, this, d);
+        
+        const int cpu = cpus[d];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int rc = pthread_setaffinity_np(m_readers.back().native_handle(), sizeof(set), &set);
+        if (rc != 0) {
+            error = "Failed to pin PHC reader thread to CPU " + std::to_string(cpu) +
+                    ": " + strerror(rc);
+            return false;
+        }
+        
+        if (m_config.realtime) {
+            sched_param param = {};
+            param.sched_priority = m_config.rtPriority;
+            rc = pthread_setschedparam(m_readers.back().native_handle(), SCHED_FIFO, &param);
+            if (rc != 0) {
+                error = std::string("Failed to set SCHED_FIFO for PHC reader thread: ") + strerror(rc);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void PHCSession::stopReaders() {
+    if (m_readers.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_readerMutex);
+        m_readersStop = true;
+    }
+    m_readerCv.notify_all();
+    for (auto& t : m_readers) {
+        t.join();
+    }
+    m_readers.clear();
+}
+
+void PHCSession::readerLoop(int d) {
+    const int numDev = m_sources.size();
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_readerMutex);
+            m_readerCv.wait(lock, [&] { return m_readersStop || m_generation != seen; });
+            if (m_readersStop) {
+                return;
+            }
+            seen = m_generation;
+        }
+        
+        // Спин-барьер: пробуждение через condvar имеет разброс в десятки мкс,
+        // поэтому ioctl запускаются только когда все потоки на месте. Спин
+        // ограничен: поток, не дождавшийся остальных, засыпает, иначе поток
+        // на том же CPU может так и не получить процессор
+        if (m_arrived.fetch_add(1) + 1 == numDev) {
+            if (m_barrierWaiters.load() > 0) {
+                std::lock_guard<std::mutex> lock(m_barrierMutex);
+                m_barrierCv.notify_all();
+            }
+        } else {
+            int spins = 0;
+            while (m_arrived.load(std::memory_order_acquire) < numDev && ++spins < BarrierSpinLimit) {
+                cpuRelax();
+            }
+            if (spins == BarrierSpinLimit) {
+                std::unique_lock<std::mutex> lock(m_barrierMutex);
+                m_barrierWaiters.fetch_add(1);
+                m_barrierCv.wait(lock, [&] { return m_arrived.load() >= numDev; });
+                m_barrierWaiters.fetch_sub(1);
+            }
+        }
+        
+        readDevice(d);
+        m_finished.fetch_add(1, std::memory_order_release);
+    }
+}
+
+PHCResult PHCSession::run() {
+    // При известном числе итераций столбцы выделяются до начала
+    // измерения, и в цикле чтения аллокатор не вызывается
+    PHCResult result;
+    PHCResultCollector collector(result, DiffPHCCore::historyLimit(m_config), m_config.count);
+    PHCResult summary = run(collector);
+    collector.finish(summary);
+    return result;
+}
+
+PHCResult PHCSession::run(MeasurementSink& sink, const std::atomic<bool>* stop) {
+    PHCResult result;
+    result.success = false;
+    result.devices = m_config.devices;
+    result.methods = m_methods;
+    result.interval = int64_t(m_config.delay) * 1000;
+    
+    if (!isOpen()) {
+        result.error = "PHC session is not open";
+        return result;
+    }
+    
+    PHCRealtimeGuard realtime;
+    if (m_config.realtime) {
+        std::string error;
+        if (!realtime.acquire(m_config, error)) {
+            result.error = error;
+            return result;
+        }
+    }
+    
+    m_readStats.assign(m_sources.size(), PHCDeviceReadStats());
+    m_running.reset(m_sources.size());
+    sink.onStart(result.devices, result.methods);
+    
+    PHCScheduler scheduler;
+    scheduler.start(int64_t(m_config.delay) * 1000);
+    for (int c = 0; m_config.count == 0 || c < m_config.count; ++c) {
+        int64_t lateness = scheduler.waitNext(stop);
+        if (stop && stop->load(std::memory_order_relaxed)) {
+            break;
+        }
+        
+        bool valid = acquire(lateness);
+        for (const auto& r : m_readings) {
+            result.samplesRead += r.samples;
+            result.samplesRejected += r.samples - r.accepted;
+        }
+        
+        PHCSampleView view = {};
+        view.sequence = m_sequence - 1;
+        view.timestamp = m_baseTimestamp;
+        view.lateness = lateness;
+        view.numDevices = m_sources.size();
+        view.offsets = m_offsets.data();
+        view.readings = m_readings.data();
+        view.valid = valid;
+        if (!sink.onSample(view)) {
+            break;
+        }
+    }
+    
+    sink.onStop();
+    result.readStats = m_readStats;
+    result.deviceSamples = deviceSamples();
+    result.missedDeadlines = scheduler.missed();
+    result.baseTimestamp = m_baseTimestamp;
+    result.running = m_running;
+    realtime.release();
+    result.success = true;
+    return result;
+}
+
+// PHCResultCollector implementation
+void PHCResultCollector::onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) {
+    m_result.devices = devices;
+    m_result.methods = methods;
+    m_result.series.reset(devices.size());
+    if (m_limit) {
+        // Хранятся только последние m_limit итераций
+        m_result.series.setLimit(m_limit);
+    } else {
+        m_result.series.reserve(m_expected);
+    }
+}
+
+bool PHCResultCollector::onSample(const PHCSampleView& sample) {
+    m_result.series.append(sample.sequence, sample.timestamp, sample.lateness,
+                           sample.offsets, sample.readings);
+    m_result.baseTimestamp = sample.timestamp;
+    return true;
+}
+
+void PHCResultCollector::finish(PHCResult& summary) {
+    m_result.success = summary.success;
+    m_result.error = summary.error;
+    m_result.devices = summary.devices;
+    m_result.methods = summary.methods;
+    m_result.interval = summary.interval;
+    m_result.missedDeadlines = summary.missedDeadlines;
+    m_result.samplesRead = summary.samplesRead;
+    m_result.samplesRejected = summary.samplesRejected;
+    m_result.readStats = summary.readStats;
+    m_result.deviceSamples = summary.deviceSamples;
+    m_result.running = std::move(summary.running);
+    
+    // Рассчитать статистику, если есть измерения
+    if (m_result.success && !m_result.series.empty()) {
+        DiffPHCCore::calculateResultStatistics(m_result);
+    }
+}
+
+// PHCScheduler implementation
+int64_t PHCScheduler::monotonicNow() {
+    return clockNow(CLOCK_MONOTONIC);
+}
+
+void PHCScheduler::start(int64_t periodNs) {
+    m_period = std::max<int64_t>(1, periodNs);
+    m_next = monotonicNow();
+    m_missed = 0;
+}
+
+int64_t PHCScheduler::waitNext(const std::atomic<bool>* stop) {
+    struct timespec deadline = {};
+    deadline.tv_sec = m_next / 1000000000LL;
+    deadline.tv_nsec = m_next % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+        if (stop && stop->load(std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    return advance(monotonicNow());
+}
+
+int64_t PHCScheduler::tick() {
+    return advance(monotonicNow());
+}
+
+int64_t PHCScheduler::timeUntilNext() const {
+    return std::max<int64_t>(0, m_next - monotonicNow());
+}
+
+int64_t PHCScheduler::advance(int64_t now) {
+    int64_t lateness = now - m_next;
+    m_next += m_period;
+    // При перегрузке пропускаем точки сетки, но сохраняем ее фазу
+    if (now >= m_next) {
+        int64_t skipped = (now - m_next) / m_period + 1;
+        m_missed += skipped;
+        m_next += skipped * m_period;
+    }
+    return lateness;
+}
+
+// PHCRealtimeGuard implementation
+PHCRealtimeGuard::~PHCRealtimeGuard() {
+    release();
+}
+
+bool PHCRealtimeGuard::acquire(const PHCConfig& config, std::string& error) {
+    release();
+    m_active = true;
+    
+    // Все страницы в памяти: page fault между двумя чтениями недопустим
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        error = std::string("mlockall failed: ") + strerror(errno);
+        release();
+        return false;
+    }
+    m_memLocked = true;
+    
+    if (config.rtCpu >= 0) {
+        pthread_getaffinity_np(pthread_self(), sizeof(m_oldAffinity), &m_oldAffinity);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config.rtCpu, &set);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) {
+            error = "Failed to pin measurement thread to CPU " + std::to_string(config.rtCpu) +
+                    ": " + strerror(rc);
+            release();
+            return false;
         }
+        m_affinityChanged = true;
+    }
+    
+    pthread_getschedparam(pthread_self(), &m_oldPolicy, &m_oldParam);
+    sched_param param = {};
+    param.sched_priority = config.rtPriority;
+    int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (rc != 0) {
+        error = std::string("Failed to set SCHED_FIFO: ") + strerror(rc);
+        release();
+        return false;
+    }
+    m_schedChanged = true;
+    
+    // Запрет глубоких C-состояний действует, пока дескриптор открыт
+    m_dmaLatencyFd = open("/dev/cpu_dma_latency", O_RDWR | O_CLOEXEC);
+    if (m_dmaLatencyFd < 0) {
+        error = std::string("Failed to open /dev/cpu_dma_latency: ") + strerror(errno);
+        release();
+        return false;
+    }
+    int32_t latency = 0;
+    if (write(m_dmaLatencyFd, &latency, sizeof(latency)) != sizeof(latency)) {
+        error = std::string("Failed to write /dev/cpu_dma_latency: ") + strerror(errno);
+        release();
+        return false;
+    }
+    
+    return true;
+}
+
+void PHCRealtimeGuard::release() {
+    if (!m_active) {
+        return;
+    }
+    if (m_dmaLatencyFd >= 0) {
+        close(m_dmaLatencyFd);
+        m_dmaLatencyFd = -1;
+    }
+    if (m_schedChanged) {
+        pthread_setschedparam(pthread_self(), m_oldPolicy, &m_oldParam);
+        m_schedChanged = false;
+    }
+    if (m_affinityChanged) {
+        pthread_setaffinity_np(pthread_self(), sizeof(m_oldAffinity), &m_oldAffinity);
+        m_affinityChanged = false;
+    }
+    if (m_memLocked) {
+        munlockall();
+        m_memLocked = false;
+    }
+    m_active = false;
+}
+
+// PHCAdaptiveSamples implementation
+void PHCAdaptiveSamples::reset(int initial, int64_t targetUncertaintyNs) {
+    m_samples = std::max(1, std::min(PTP_MAX_SAMPLES, initial));
+    m_target = targetUncertaintyNs;
+    m_uncertainty = 0.0;
+    m_rejection = 0.0;
+    m_primed = false;
+}
+
+void PHCAdaptiveSamples::update(const PHCReading& reading) {
+    if (reading.samples <= 0 || (reading.error && reading.error != ENODATA)) {
+        return;
+    }
+    
+    double rejection = 1.0 - double(reading.accepted) / reading.samples;
+    // Без принятых отсчетов оценка неопределенности не определена -
+    // считаем ее заведомо выше цели
+    double uncertainty = reading.accepted
+        ? reading.meanDelay / 2.0 / std::sqrt(double(reading.accepted))
+        : 2.0 * m_target;
+    
+    const double alpha = 0.2;
+    if (!m_primed) {
+        m_uncertainty = uncertainty;
+        m_rejection = rejection;
+        m_primed = true;
+    } else {
+        m_uncertainty += alpha * (uncertainty - m_uncertainty);
+        m_rejection += alpha * (rejection - m_rejection);
+    }
+    
+    if (m_uncertainty > m_target || m_rejection > 0.2) {
+        if (m_samples < PTP_MAX_SAMPLES) {
+            m_samples = std::min(PTP_MAX_SAMPLES, m_samples * 2);
+            m_primed = false;   // Новое число отсчетов - новая статистика
+        }
+    } else if (m_uncertainty < m_target / 2.0 && m_samples > 1) {
+        m_samples--;
+        m_primed = false;
+    }
+}
+
+// PHCDeviceReadStats implementation
+void PHCDeviceReadStats::add(const PHCReading& reading) {
+    reads++;
+    samples += reading.samples;
+    accepted += reading.accepted;
+    callTotalNs += reading.callNs;
+    callMaxNs = std::max(callMaxNs, reading.callNs);
+    if (!reading.ok()) {
+        errors++;
+        return;
+    }
+    delayTotalNs += reading.meanDelay;
+    if (reads - errors == 1 || reading.minDelay < minDelay) {
+        minDelay = reading.minDelay;
+    }
+}
+
+// PHCSeries implementation
+void PHCSeries::reset(size_t numDevices) {
+    m_numDevices = numDevices;
+    m_capacity = 0;
+    m_head = 0;
+    m_size = 0;
+    m_sequences.clear();
+    m_timestamps.clear();
+    m_lateness.clear();
+    m_valid.clear();
+    m_offsets.clear();
+    m_readings.clear();
+    m_evictOffsets.assign(numDevices, 0);
+    m_evictReadings.assign(numDevices, PHCReading());
+    if (m_limit) {
+        relayout(m_limit);
+    }
+}
+
+void PHCSeries::clear() {
+    m_head = 0;
+    m_size = 0;
+}
+
+void PHCSeries::reserve(size_t rows) {
+    if (!m_limit && rows > m_capacity) {
+        relayout(roundUp(rows));
+    }
+}
+
+void PHCSeries::setLimit(size_t rows) {
+    m_limit = rows ? roundUp(rows) : 0;
+    if (!m_limit) {
+        return;
+    }
+    while (m_size > m_limit) {
+        evictOldest();
+    }
+    relayout(m_limit);
+}
+
+size_t PHCSeries::roundUp(size_t rows) {
+    size_t capacity = 1;
+    while (capacity < rows) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+size_t PHCSeries::bytesPerRow(size_t numDevices) {
+    return sizeof(uint64_t) + 2 * sizeof(int64_t) + sizeof(uint8_t) +
+           numDevices * (sizeof(int64_t) + sizeof(PHCReading));
+}
+
+size_t PHCSeries::rowsForMemory(size_t bytes, size_t numDevices) {
+    size_t rows = bytes / bytesPerRow(numDevices);
+    if (rows == 0) {
+        return 0;
+    }
+    size_t capacity = 1;
+    while (capacity * 2 <= rows) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+void PHCSeries::relayout(size_t capacity) {
+    // Строки переносятся в линейном порядке, столбцы устройств - на новый шаг
+    std::vector<uint64_t> sequences(capacity);
+    std::vector<int64_t> timestamps(capacity);
+    std::vector<int64_t> lateness(capacity);
+    std::vector<uint8_t> valid(capacity);
+    std::vector<int64_t> offsets(m_numDevices * capacity);
+    std::vector<PHCReading> readings(m_numDevices * capacity);
+    for (size_t row = 0; row < m_size; ++row) {
+        const size_t from = slot(row);
+        sequences[row] = m_sequences[from];
+        timestamps[row] = m_timestamps[from];
+        lateness[row] = m_lateness[from];
+        valid[row] = m_valid[from];
+        for (size_t d = 0; d < m_numDevices; ++d) {
+            offsets[d * capacity + row] = m_offsets[d * m_capacity + from];
+            readings[d * capacity + row] = m_readings[d * m_capacity + from];
+        }
+    }
+    m_sequences.swap(sequences);
+    m_timestamps.swap(timestamps);
+    m_lateness.swap(lateness);
+    m_valid.swap(valid);
+    m_offsets.swap(offsets);
+    m_readings.swap(readings);
+    m_capacity = capacity;
+    m_head = 0;
+}
+
+void PHCSeries::evictOldest() {
+    if (m_evictionSink) {
+        for (size_t d = 0; d < m_numDevices; ++d) {
+            m_evictOffsets[d] = offset(0, d);
+            m_evictReadings[d] = reading(0, d);
+        }
+        PHCSampleView view = {};
+        view.sequence = sequence(0);
+        view.timestamp = timestamp(0);
+        view.lateness = lateness(0);
+        view.numDevices = m_numDevices;
+        view.offsets = m_evictOffsets.data();
+        view.readings = m_evictReadings.data();
+        view.valid = valid(0);
+        m_evictionSink->onSample(view);
+    }
+    m_head = (m_head + 1) & (m_capacity - 1);
+    m_size--;
+}
+
+void PHCSeries::append(uint64_t sequence, int64_t timestamp, int64_t lateness,
+                       const int64_t* offsets, const PHCReading* readings) {
+    if (m_limit) {
+        if (m_size == m_capacity) {
+            evictOldest();
+        }
+    } else if (m_size == m_capacity) {
+        relayout(m_capacity ? m_capacity * 2 : 16);
+    }
+    
+    const size_t to = slot(m_size);
+    bool ok = true;
+    for (size_t d = 0; d < m_numDevices; ++d) {
+        m_offsets[d * m_capacity + to] = offsets[d];
+        m_readings[d * m_capacity + to] = readings[d];
+        ok = ok && readings[d].ok();
+    }
+    m_sequences[to] = sequence;
+    m_timestamps[to] = timestamp;
+    m_lateness[to] = lateness;
+    m_valid[to] = ok;
+    m_size++;
+}
+
+void PHCSeries::append(const PHCSeries& other, size_t row) {
+    for (size_t d = 0; d < m_numDevices; ++d) {
+        m_evictOffsets[d] = other.offset(row, d);
+        m_evictReadings[d] = other.reading(row, d);
+    }
+    append(other.sequence(row), other.timestamp(row), other.lateness(row),
+           m_evictOffsets.data(), m_evictReadings.data());
+}
+
+void PHCSeries::pairColumn(size_t i, size_t j, std::vector<int64_t>& out) const {
+    out.clear();
+    for (size_t row = 0; row < m_size; ++row) {
+        const size_t at = slot(row);
+        if (m_valid[at]) {
+            out.push_back(m_offsets[i * m_capacity + at] - m_offsets[j * m_capacity + at]);
+        }
+    }
+}
+
+void PHCSeries::latenessColumn(std::vector<int64_t>& out) const {
+    out.clear();
+    out.reserve(m_size);
+    for (size_t row = 0; row < m_size; ++row) {
+        out.push_back(m_lateness[slot(row)]);
     }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <linux/ptp_clock.h>
+#include <sched.h>
 #include <linux/sockios.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,19 +17,134 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include <string>
 
+#include "diffphc_quantile.h"
+
+// Способ чтения пары PHC/системное время
+enum class PHCReadMethod {
+    Auto,       // Выбрать лучший поддерживаемый устройством
+    Precise,    // PTP_SYS_OFFSET_PRECISE (аппаратный cross-timestamp)
+    Extended,   // PTP_SYS_OFFSET_EXTENDED
+    Basic,      // PTP_SYS_OFFSET
+    Direct,     // clock_gettime() динамических POSIX часов (FD_TO_CLOCKID)
+    None        // Устройство не поддерживает ни один способ
+};
+
+// Результат одного чтения PHC: смещение и его качество. Отсчеты
+// с задержкой вызова больше минимальной на PHCCallMaxDelay отбрасываются.
+struct PHCReading {
+    int64_t offset = 0;         // Смещение PHC относительно CLOCK_REALTIME (нс)
+    int64_t minDelay = 0;       // Минимальная задержка вызова среди принятых (нс)
+    int64_t meanDelay = 0;      // Средняя задержка вызова среди принятых (нс)
+    int samples = 0;            // Запрошено отсчетов
+    int accepted = 0;           // Принято отсчетов
+    int64_t callNs = 0;         // Длительность ioctl (нс)
+    int error = 0;              // 0 - успех, иначе errno (ENODATA - все отсчеты отброшены)
+    
+    bool ok() const { return error == 0; }
+};
+
+// Сводка чтений одного устройства за измерение
+struct PHCDeviceReadStats {
+    uint64_t reads = 0;
+    uint64_t errors = 0;
+    uint64_t samples = 0;
+    uint64_t accepted = 0;
+    int64_t callTotalNs = 0;
+    int64_t callMaxNs = 0;
+    int64_t delayTotalNs = 0;   // Сумма средних задержек успешных чтений
+    int64_t minDelay = 0;       // Минимальная задержка за все успешные чтения
+    
+    void add(const PHCReading& reading);
+    double meanCallNs() const { return reads ? double(callTotalNs) / reads : 0.0; }
+    double meanDelay() const { return reads > errors ? double(delayTotalNs) / (reads - errors) : 0.0; }
+};
+
+// Адаптивный выбор числа отсчетов ioctl для одного устройства.
+// Неопределенность чтения оценивается как половина средней задержки
+// вызова, деленная на корень из числа принятых отсчетов. Число отсчетов
+// растет вдвое, пока оценка выше цели или отбраковка превышает 20%,
+// и уменьшается на единицу, пока оценка ниже половины цели.
+class PHCAdaptiveSamples {
+public:
+    void reset(int initial, int64_t targetUncertaintyNs);
+    void update(const PHCReading& reading);
+    int samples() const { return m_samples; }
+    double uncertainty() const { return m_uncertainty; }
+
+private:
+    int m_samples = 1;
+    int64_t m_target = 0;
+    double m_uncertainty = 0.0;     // EWMA оценки неопределенности, нс
+    double m_rejection = 0.0;       // EWMA доли отброшенных отсчетов
+    bool m_primed = false;
+};
+
+class PHCClockSource;
+class MeasurementSink;
+class PHCCompressedSeries;
+
+// Результат сравнения способов чтения одного устройства
+struct PHCReadBenchmark {
+    PHCReadMethod method;
+    bool supported;
+    size_t iterations;
+    double meanCallNs;      // Средняя длительность вызова
+    int64_t minCallNs;      // Минимальная длительность вызова
+    double medianCallNs;    // Медианная длительность вызова
+    double offsetStdDev;    // Разброс оценки смещения PHC-система
+};
+
+// Параметры модели PHC для симуляции (см. PHCSimulatedSource)
+struct PHCSimulationParams {
+    int64_t offset = 0;             // Начальное смещение относительно CLOCK_REALTIME (нс)
+    double drift = 0.0;             // Постоянный уход частоты (ppb)
+    double wander = 0.0;            // Случайное блуждание частоты (ppb/√с)
+    double stepInterval = 0.0;      // Средний интервал между скачками фазы (с, 0 = без скачков)
+    int64_t stepSize = 0;           // Величина скачка фазы (нс)
+    int64_t latencyMin = 500;       // Минимальная задержка вызова (нс)
+    double latencyJitter = 200.0;   // Среднее экспоненциального хвоста задержки (нс)
+    double outlierRate = 0.0;       // Доля отсчетов с выбросом задержки
+    int64_t outlierLatency = 200000;    // Добавка задержки при выбросе (нс)
+    bool precise = false;           // Модель поддерживает PTP_SYS_OFFSET_PRECISE
+    uint64_t seed = 1;              // Зерно генератора; устройство N использует seed + N
+};
+
 struct PHCConfig {
     int count = 0;
     int delay = 100000;
     int samples = 10;
     bool info = false;
     bool debug = false;
+    bool parallel = false;      // Отдельный поток чтения на каждое устройство
+    std::vector<int> cpus;      // CPU для закрепления потоков чтения (пусто = по кругу)
+    PHCReadMethod method = PHCReadMethod::Auto;
+    std::map<int, PHCReadMethod> deviceMethods;  // Переопределение способа для устройства
+    bool realtime = false;      // SCHED_FIFO, mlockall, закрепление CPU, cpu_dma_latency
+    int rtPriority = 80;        // Приоритет SCHED_FIFO
+    int rtCpu = -1;             // CPU для измерительного потока (-1 = не закреплять)
+    bool adaptiveSamples = false;       // Подбирать число отсчетов для каждого устройства
+    int64_t targetUncertainty = 100;    // Целевая неопределенность чтения для адаптации (нс)
+    bool simulate = false;              // Вместо /dev/ptpN использовать модели PHC
+    PHCSimulationParams simulation;     // Модель по умолчанию для всех устройств
+    std::map<int, PHCSimulationParams> deviceSimulation;   // Модель для отдельного устройства
+    size_t historySize = 0;             // Строк истории в памяти (0 - все при count > 0)
+    size_t historyMemory = 0;           // Бюджет памяти истории в байтах (0 - по historySize)
     std::vector<int> devices;
 };
 
@@ -40,17 +156,289 @@ struct PHCStatistics {
     double stddev;          // Стандартное отклонение
     int64_t range;          // Размах (max - min)
     size_t count;           // Количество измерений
+    double p1;              // Процентили: 1 %
+    double p5;              // 5 %
+    double p95;             // 95 %
+    double p99;             // 99 %
+    double p999;            // 99.9 %
 };
 
+// Потоковая статистика одной величины: минимум, максимум, среднее и
+// дисперсия по Уэлфорду за O(1) на значение без хранения самих значений.
+// Агрегаты разных отрезков сливаются по формуле Чана.
+struct PHCRunningStats {
+    uint64_t count = 0;
+    int64_t minimum = 0;
+    int64_t maximum = 0;
+    double mean = 0.0;
+    double m2 = 0.0;            // Сумма квадратов отклонений от среднего
+
+    void add(int64_t value) {
+        if (count == 0) {
+            minimum = maximum = value;
+        } else if (value < minimum) {
+            minimum = value;
+        } else if (value > maximum) {
+            maximum = value;
+        }
+        count++;
+        double delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+    }
+    void merge(const PHCRunningStats& other);
+    int64_t range() const { return maximum - minimum; }
+    // Несмещенная оценка дисперсии
+    double variance() const { return count > 1 ? m2 / (count - 1) : 0.0; }
+    double stddev() const { return std::sqrt(variance()); }
+    // Сводка в виде PHCStatistics без медианы и процентилей (нули)
+    PHCStatistics statistics() const;
+};
+
+// Разности пар устройств одной итерации, вычисляемые из смещений по
+// запросу. Смещение устройства d лежит по адресу offsets[d * stride].
+// Пары перечисляются в порядке нижнего треугольника с диагональю:
+// (0,0), (1,0), (1,1), (2,0), ...
+class PHCPairView {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int64_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = int64_t;
+
+        iterator(const int64_t* offsets, size_t stride, size_t i, size_t j)
+            : m_offsets(offsets), m_stride(stride), m_i(i), m_j(j) {}
+        int64_t operator*() const { return m_offsets[m_i * m_stride] - m_offsets[m_j * m_stride]; }
+        iterator& operator++() {
+            if (++m_j > m_i) {
+                ++m_i;
+                m_j = 0;
+            }
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return m_i == other.m_i && m_j == other.m_j; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+        size_t first() const { return m_i; }
+        size_t second() const { return m_j; }
+
+    private:
+        const int64_t* m_offsets;
+        size_t m_stride;
+        size_t m_i;
+        size_t m_j;
+    };
+
+    PHCPairView() = default;
+    PHCPairView(const int64_t* offsets, size_t numDevices, size_t stride = 1)
+        : m_offsets(offsets), m_numDevices(numDevices), m_stride(stride) {}
+
+    size_t numDevices() const { return m_numDevices; }
+    size_t size() const { return m_numDevices * (m_numDevices + 1) / 2; }
+    bool empty() const { return m_numDevices == 0; }
+
+    // Разность устройств i и j
+    int64_t operator()(size_t i, size_t j) const { return m_offsets[i * m_stride] - m_offsets[j * m_stride]; }
+    // Разность по номеру пары в порядке нижнего треугольника
+    int64_t operator[](size_t index) const {
+        size_t i = size_t((std::sqrt(8.0 * index + 1) - 1) / 2);
+        while (i * (i + 1) / 2 > index) --i;
+        while ((i + 1) * (i + 2) / 2 <= index) ++i;
+        return (*this)(i, index - i * (i + 1) / 2);
+    }
+    static size_t index(size_t i, size_t j) { return i * (i + 1) / 2 + j; }
+
+    iterator begin() const { return iterator(m_offsets, m_stride, 0, 0); }
+    iterator end() const { return iterator(m_offsets, m_stride, m_numDevices, 0); }
+
+private:
+    const int64_t* m_offsets = nullptr;
+    size_t m_numDevices = 0;
+    size_t m_stride = 1;
+};
+
+// Потоковая статистика измерения: все пары устройств в порядке
+// PHCPairView::index и опоздание планировщика. Обновляется в цикле
+// измерения на каждой итерации, поэтому текущие значения доступны в
+// любой момент; итерации с ошибкой чтения в статистику пар не попадают.
+// Медиана и процентили оцениваются эскизом квантилей в памяти,
+// не зависящей от длительности измерения.
+struct PHCRunningSummary {
+    size_t numDevices = 0;
+    std::vector<PHCRunningStats> pairs;
+    std::vector<PHCQuantileSketch> quantiles;   // Параллельно pairs
+    PHCRunningStats lateness;
+    PHCQuantileSketch latenessQuantiles;
+
+    void reset(size_t devices) {
+        numDevices = devices;
+        pairs.assign(devices * (devices + 1) / 2, PHCRunningStats());
+        quantiles.assign(pairs.size(), PHCQuantileSketch());
+        lateness = PHCRunningStats();
+        latenessQuantiles.reset();
+    }
+    void add(int64_t latenessNs, const PHCPairView& view, bool valid) {
+        lateness.add(latenessNs);
+        latenessQuantiles.add(latenessNs);
+        if (!valid || view.numDevices() != numDevices) {
+            return;
+        }
+        auto* stats = pairs.data();
+        auto* sketch = quantiles.data();
+        for (int64_t diff : view) {
+            (stats++)->add(diff);
+            (sketch++)->add(diff);
+        }
+    }
+    bool empty() const { return lateness.count == 0; }
+    const PHCRunningStats& pair(size_t i, size_t j) const { return pairs[PHCPairView::index(i, j)]; }
+    // Полная сводка пары (i, j) и опоздания планировщика
+    PHCStatistics pairStatistics(size_t i, size_t j) const;
+    PHCStatistics latenessStatistics() const;
+};
+
+// Колоночное хранилище измерений сессии: отдельные столбцы для номера
+// итерации, метки времени, опоздания планировщика и смещения каждого
+// устройства. Столбцы устройств лежат в одном буфере с шагом capacity,
+// поэтому строка доступна как PHCPairView без копирования.
+//
+// Без ограничения хранилище растет удвоением (добавление амортизированно
+// O(1), после reserve() без аллокаций). С setLimit() оно становится
+// кольцевым буфером фиксированной емкости - степени двойки: новая строка
+// замещает самую старую, а вытесненная строка передается приемнику
+// вытеснения. Строки нумеруются от самой старой (0) к самой новой.
+class PHCSeries {
+public:
+    // Очистить и задать число устройств; ограничение емкости сохраняется
+    void reset(size_t numDevices);
+    // Удалить строки, сохранив выделенную память
+    void clear();
+    void reserve(size_t rows);
+    // Кольцевой режим на rows строк (округляется вверх до степени двойки),
+    // 0 - без ограничения. Лишние старые строки вытесняются.
+    void setLimit(size_t rows);
+    size_t limit() const { return m_limit; }
+    // Приемник вытесненных строк (не владеет им, nullptr - отбрасывать)
+    void setEvictionSink(MeasurementSink* sink) { m_evictionSink = sink; }
+    
+    void append(uint64_t sequence, int64_t timestamp, int64_t lateness,
+                const int64_t* offsets, const PHCReading* readings);
+    // Дописать строку row другого хранилища с тем же числом устройств
+    void append(const PHCSeries& other, size_t row);
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_t numDevices() const { return m_numDevices; }
+    size_t capacity() const { return m_capacity; }
+    // Байт памяти на одну строку при numDevices устройствах
+    static size_t bytesPerRow(size_t numDevices);
+    // Емкость кольца, укладывающаяся в бюджет памяти (степень двойки вниз)
+    static size_t rowsForMemory(size_t bytes, size_t numDevices);
+
+    uint64_t sequence(size_t row) const { return m_sequences[slot(row)]; }
+    int64_t timestamp(size_t row) const { return m_timestamps[slot(row)]; }
+    int64_t lateness(size_t row) const { return m_lateness[slot(row)]; }
+    int64_t offset(size_t row, size_t device) const { return m_offsets[device * m_capacity + slot(row)]; }
+    const PHCReading& reading(size_t row, size_t device) const {
+        return m_readings[device * m_capacity + slot(row)];
+    }
+    // Все устройства итерации прочитаны без ошибок
+    bool valid(size_t row) const { return m_valid[slot(row)] != 0; }
+    PHCPairView pairs(size_t row) const {
+        return PHCPairView(m_offsets.data() + slot(row), m_numDevices, m_capacity);
+    }
+    // Разности пары (i, j) по всем итерациям без ошибок чтения
+    void pairColumn(size_t i, size_t j, std::vector<int64_t>& out) const;
+    // Опоздания планировщика всех итераций
+    void latenessColumn(std::vector<int64_t>& out) const;
+
+private:
+    // Емкость всегда степень двойки, поэтому кольцо адресуется маской
+    size_t slot(size_t row) const { return (m_head + row) & (m_capacity - 1); }
+    static size_t roundUp(size_t rows);
+    void relayout(size_t capacity);
+    void evictOldest();
+
+    size_t m_numDevices = 0;
+    size_t m_capacity = 0;
+    size_t m_limit = 0;         // 0 - рост без ограничения, иначе емкость кольца
+    size_t m_head = 0;          // Слот самой старой строки
+    size_t m_size = 0;
+    std::vector<uint64_t> m_sequences;
+    std::vector<int64_t> m_timestamps;
+    std::vector<int64_t> m_lateness;
+    std::vector<uint8_t> m_valid;
+    std::vector<int64_t> m_offsets;         // Столбец на устройство, шаг m_capacity
+    std::vector<PHCReading> m_readings;     // Столбец на устройство, шаг m_capacity
+    
+    MeasurementSink* m_evictionSink = nullptr;
+    std::vector<int64_t> m_evictOffsets;    // Строка для приемника вытеснения
+    std::vector<PHCReading> m_evictReadings;
+};
+
+// Емкость истории непрерывного измерения по умолчанию (строк)
+constexpr size_t PHC_DEFAULT_HISTORY = size_t(1) << 16;
+
 struct PHCResult {
     std::vector<int> devices;
-    std::vector<std::vector<int64_t>> differences;
-    int64_t baseTimestamp;
+    std::vector<PHCReadMethod> methods;   // Способ чтения каждого устройства
+    // Измерения по итерациям: номер, метка времени, опоздание
+    // планировщика, смещение и чтение каждого устройства; разности пар
+    // дает pairs()
+    PHCSeries series;
+    int64_t baseTimestamp;      // Метка времени последней итерации
+    int64_t interval = 0;       // Интервал сетки итераций, τ0 фазовых данных (нс)
     bool success;
     std::string error;
     
     // Статистика по парам устройств
     std::vector<std::vector<PHCStatistics>> statistics;
+    // Потоковая статистика всех итераций измерения, включая вытесненные
+    // из series
+    PHCRunningSummary running;
+    
+    // Статистика опоздания пробуждения относительно сетки (нс)
+    PHCStatistics scheduling = {};
+    uint64_t missedDeadlines = 0;
+    
+    // Отсчеты ioctl, запрошенные и отброшенные по задержке вызова
+    uint64_t samplesRead = 0;
+    uint64_t samplesRejected = 0;
+    // Сводка чтений по устройствам
+    std::vector<PHCDeviceReadStats> readStats;
+    // Число отсчетов на чтение для каждого устройства в конце измерения
+    std::vector<int> deviceSamples;
+    
+    PHCPairView pairs(size_t iteration) const { return series.pairs(iteration); }
+};
+
+// Планировщик итераций на фиксированной сетке абсолютных дедлайнов
+// (clock_nanosleep с TIMER_ABSTIME по CLOCK_MONOTONIC): время обработки
+// итерации не накапливается, а опоздание каждого пробуждения измеряется.
+class PHCScheduler {
+public:
+    void start(int64_t periodNs);
+    // Дождаться следующего дедлайна, вернуть опоздание пробуждения.
+    // Сигнал прерывает ожидание, если выставлен флаг stop.
+    int64_t waitNext(const std::atomic<bool>* stop = nullptr);
+    // Неблокирующий вариант для внешних таймеров: отметить срабатывание
+    int64_t tick();
+    // Время до следующего дедлайна (0, если он уже наступил)
+    int64_t timeUntilNext() const;
+
+    int64_t period() const { return m_period; }
+    uint64_t missed() const { return m_missed; }
+
+    static int64_t monotonicNow();
+
+private:
+    int64_t advance(int64_t now);
+
+    int64_t m_period = 0;
+    int64_t m_next = 0;
+    uint64_t m_missed = 0;
 };
 
 class DiffPHCCore {
@@ -65,21 +453,231 @@ public:
     static int openPHC(const std::string& pch_path);
     static bool printClockInfo(int phc_index);
     static void printClockInfoAll();
-    static int64_t getPTPSysOffsetExtended(int clkPTPid, int samples);
+    static PHCReading getPTPSysOffsetExtended(int clkPTPid, int samples);
+    static PHCReading getPTPSysOffsetPrecise(int clkPTPid);
+    static PHCReading getPTPSysOffsetBasic(int clkPTPid, int samples);
+    static PHCReading getPHCDirect(int clkPTPid, int samples);
+    static PHCReading readPHC(int clkPTPid, PHCReadMethod method, int samples);
+    
+    // Read method selection
+    static bool supportsReadMethod(int clkPTPid, PHCReadMethod method);
+    static PHCReadMethod probeReadMethod(int clkPTPid);
+    static const char* readMethodName(PHCReadMethod method);
+    static bool parseReadMethod(const std::string& name, PHCReadMethod& method);
+    static std::vector<PHCReadBenchmark> benchmarkReadMethods(int phc_index, int iterations, int samples);
+    static std::vector<PHCReadBenchmark> benchmarkReadMethods(PHCClockSource& source, int iterations, int samples);
+    
+    // Оценка смещения по отсчетам t0 (система) - t1 (PHC) - t2 (система),
+    // общая для всех источников с многоотсчетным чтением
+    static void estimateOffset(const int64_t* t0, const int64_t* t1, const int64_t* t2,
+                               int samples, PHCReading& reading);
     
     // High level operations
     static PHCResult measurePHCDifferences(const PHCConfig& config);
     static std::vector<int> getAvailablePHCDevices();
     static bool validateConfig(const PHCConfig& config, std::string& error);
+    static bool validateParameters(const PHCConfig& config, std::string& error);
+    // Емкость кольца истории для config (0 - хранить все итерации)
+    static size_t historyLimit(const PHCConfig& config);
     static bool requiresRoot();
     static bool checkPTPDevicesAvailable(std::string& error);
     
     // Statistical analysis
     static PHCStatistics calculateStatistics(const std::vector<int64_t>& values);
-    static void calculateResultStatistics(PHCResult& result);
-    static double calculateMedian(std::vector<int64_t> values);
+    // archive - вытесненные из result.series итерации, идущие перед ними.
+    // Если в памяти и архиве хранятся не все итерации, сводка берется из
+    // потоковой статистики result.running (квантили - оценка эскиза).
+    static void calculateResultStatistics(PHCResult& result, const PHCCompressedSeries* archive = nullptr);
+    // Как calculateStatistics, но квантили выбираются прямо в values
+    // (порядок меняется) с рабочими буферами selector
+    static PHCStatistics calculateStatisticsInPlace(std::vector<int64_t>& values, PHCQuantileSelector& selector);
+    static double calculateMedian(const std::vector<int64_t>& values);
     static double calculateMean(const std::vector<int64_t>& values);
     static double calculateStdDev(const std::vector<int64_t>& values, double mean);
 };
 
+// Данные одной итерации, передаваемые потребителю без копирования.
+// Указатели действительны только на время вызова onSample().
+struct PHCSampleView {
+    uint64_t sequence;              // Номер итерации в сессии
+    int64_t timestamp;              // Базовая метка времени итерации (CLOCK_REALTIME, нс)
+    int64_t lateness;               // Опоздание пробуждения планировщика (нс)
+    size_t numDevices;
+    const int64_t* offsets;         // Смещение каждого устройства, N значений
+    const PHCReading* readings;     // Чтение каждого устройства, N значений
+    bool valid;                     // Все устройства прочитаны без ошибок
+    
+    PHCPairView pairs() const { return PHCPairView(offsets, numDevices); }
+};
+
+// Потребитель потока измерений: получает каждую итерацию сразу после
+// чтения, без накопления в PHCResult
+class MeasurementSink {
+public:
+    virtual ~MeasurementSink() = default;
+    virtual void onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) {
+        (void)devices;
+        (void)methods;
+    }
+    // false - остановить измерение
+    virtual bool onSample(const PHCSampleView& sample) = 0;
+    virtual void onStop() {}
+};
+
+// Приемник на основе функции обратного вызова
+class PHCCallbackSink : public MeasurementSink {
+public:
+    explicit PHCCallbackSink(std::function<bool(const PHCSampleView&)> callback)
+        : m_callback(std::move(callback)) {}
+    bool onSample(const PHCSampleView& sample) override { return m_callback(sample); }
+
+private:
+    std::function<bool(const PHCSampleView&)> m_callback;
+};
+
+// Разветвитель потока: передает каждую итерацию всем приемникам по
+// порядку добавления (не владеет ими)
+class PHCMultiSink : public MeasurementSink {
+public:
+    void add(MeasurementSink* sink) { m_sinks.push_back(sink); }
+    void onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) override {
+        for (auto* sink : m_sinks) {
+            sink->onStart(devices, methods);
+        }
+    }
+    // false, если хотя бы один приемник остановил измерение
+    bool onSample(const PHCSampleView& sample) override {
+        bool proceed = true;
+        for (auto* sink : m_sinks) {
+            proceed = sink->onSample(sample) && proceed;
+        }
+        return proceed;
+    }
+    void onStop() override {
+        for (auto* sink : m_sinks) {
+            sink->onStop();
+        }
+    }
+
+private:
+    std::vector<MeasurementSink*> m_sinks;
+};
+
+// Буферизующий приемник: накапливает итерации в PHCResult так же, как
+// PHCSession::run(), чтобы потоковый прогон с другими приемниками давал
+// тот же результат. limit - наибольшее число хранимых итераций (0 - все),
+// expected - число итераций для резервирования столбцов до измерения.
+class PHCResultCollector : public MeasurementSink {
+public:
+    PHCResultCollector(PHCResult& result, size_t limit, size_t expected = 0)
+        : m_result(result), m_limit(limit), m_expected(expected) {}
+
+    void onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) override;
+    bool onSample(const PHCSampleView& sample) override;
+    // Перенести в результат сводку прогона run(sink) и рассчитать статистику
+    void finish(PHCResult& summary);
+
+private:
+    PHCResult& m_result;
+    size_t m_limit;
+    size_t m_expected;
+};
+
+// Режим реального времени на время измерения: SCHED_FIFO, mlockall,
+// закрепление на CPU и удержание /dev/cpu_dma_latency в 0. Деструктор
+// возвращает прежние настройки.
+class PHCRealtimeGuard {
+public:
+    PHCRealtimeGuard() = default;
+    ~PHCRealtimeGuard();
+    PHCRealtimeGuard(const PHCRealtimeGuard&) = delete;
+    PHCRealtimeGuard& operator=(const PHCRealtimeGuard&) = delete;
+
+    bool acquire(const PHCConfig& config, std::string& error);
+    void release();
+    bool active() const { return m_active; }
+
+private:
+    bool m_active = false;
+    bool m_schedChanged = false;
+    int m_oldPolicy = SCHED_OTHER;
+    sched_param m_oldParam = {};
+    bool m_memLocked = false;
+    bool m_affinityChanged = false;
+    cpu_set_t m_oldAffinity;
+    int m_dmaLatencyFd = -1;
+};
+
+// Долгоживущая сессия измерений: устройства открываются, проверяются
+// и кэшируются один раз, после чего каждая итерация стоит только ioctl.
+class PHCSession {
+public:
+    PHCSession() = default;
+    ~PHCSession();
+    PHCSession(const PHCSession&) = delete;
+    PHCSession& operator=(const PHCSession&) = delete;
+
+    bool open(const PHCConfig& config, std::string& error);
+    void close();
+    bool isOpen() const { return !m_sources.empty(); }
+
+    // Одна итерация измерения, строка дописывается в result.series
+    bool sampleOnce(PHCResult& result, int64_t lateness = 0);
+    // Одна итерация с перезаписью единственной строки result.series:
+    // после первого вызова память не выделяется
+    bool sampleLatest(PHCResult& result, int64_t lateness = 0);
+    // Полный прогон config.count итераций (0 = бесконечно)
+    PHCResult run();
+    // Потоковый прогон: каждая итерация передается в sink и не хранится.
+    // Останавливается по счетчику, по false из sink или по флагу stop.
+    // Возвращает сводку без измерений (ошибка, счетчики отсчетов, дедлайны).
+    PHCResult run(MeasurementSink& sink, const std::atomic<bool>* stop = nullptr);
+
+    const PHCConfig& config() const { return m_config; }
+    const std::vector<ptp_clock_caps>& capabilities() const { return m_caps; }
+    const std::vector<PHCReadMethod>& methods() const { return m_methods; }
+    std::vector<int> deviceSamples() const;
+    // Потоковая статистика итераций с последнего open() или resetStatistics()
+    const PHCRunningSummary& statistics() const { return m_running; }
+    void resetStatistics() { m_running.reset(m_sources.size()); }
+
+private:
+    // Прочитать все устройства и обновить потоковую статистику
+    bool acquire(int64_t lateness);
+    void accountReadings(PHCResult& result) const;
+    void readDevice(int d);
+    void sampleSequential();
+    void sampleParallel();
+    bool startReaders(std::string& error);
+    void stopReaders();
+    void readerLoop(int d);
+
+    PHCConfig m_config;
+    std::vector<std::unique_ptr<PHCClockSource>> m_sources;
+    std::vector<ptp_clock_caps> m_caps;
+    std::vector<PHCReadMethod> m_methods;
+    std::vector<int64_t> m_offsets;
+    std::vector<PHCReading> m_readings;
+    std::vector<PHCDeviceReadStats> m_readStats;
+    std::vector<PHCAdaptiveSamples> m_adaptive;
+    int64_t m_baseTimestamp = 0;
+    uint64_t m_sequence = 0;
+    PHCRunningSummary m_running;
+
+    // Параллельный режим: потоки будятся через condition variable,
+    // затем выравниваются на спин-барьере и читают устройства одновременно.
+    // Не дождавшийся остальных за BarrierSpinLimit итераций поток спит на
+    // m_barrierCv, последний пришедший будит его
+    std::vector<std::thread> m_readers;
+    std::mutex m_readerMutex;
+    std::condition_variable m_readerCv;
+    uint64_t m_generation = 0;
+    bool m_readersStop = false;
+    std::atomic<int> m_arrived{0};
+    std::atomic<int> m_finished{0};
+    std::mutex m_barrierMutex;
+    std::condition_variable m_barrierCv;
+    std::atomic<int> m_barrierWaiters{0};
+};
+
 #endif // DIFFPHC_CORE_H
\ No newline at end of file
@@ -18,6 +18,7 @@
 #include <QThread>
 #include <QProcess>
 #include <QFileInfo>
+#include <QInputDialog>
 #include <cmath>
 #include <algorithm>
 
@@ -50,6 +51,9 @@ ShiwaDiffPHCMainWindow::ShiwaDiffPHCMainWindow(QWidget *parent)
     
     updateDeviceList();
     
+    // Таймер перевзводится на каждой итерации по сетке дедлайнов планировщика
+    m_measurementTimer->setSingleShot(true);
+    m_measurementTimer->setTimerType(Qt::PreciseTimer);
     connect(m_measurementTimer, &QTimer::timeout, this, &ShiwaDiffPHCMainWindow::onTimerUpdate);
     
     // Web server connections
@@ -203,6 +207,12 @@ void ShiwaDiffPHCMainWindow::setupMenuBar() {
     auto* anomalyDetectionAction = analysisMenu->addAction("&Anomaly Detection");
     connect(anomalyDetectionAction, &QAction::triggered, this, &ShiwaDiffPHCMainWindow::onAnomalyDetection);
     
+    auto* stabilityAnalysisAction = analysisMenu->addAction("S&tability (ADEV/TDEV)");
+    connect(stabilityAnalysisAction, &QAction::triggered, this, &ShiwaDiffPHCMainWindow::onStabilityAnalysis);
+    
+    auto* mtieAnalysisAction = analysisMenu->addAction("&MTIE / Mask Check");
+    connect(mtieAnalysisAction, &QAction::triggered, this, &ShiwaDiffPHCMainWindow::onMtieAnalysis);
+    
     analysisMenu->addSeparator();
     
     auto* generateReportAction = analysisMenu->addAction("Generate &Report");
@@ -341,6 +351,15 @@ void ShiwaDiffPHCMainWindow::setupResultsPanel() {
     m_statisticsTable->horizontalHeader()->setStretchLastSection(true);
     statisticsLayout->addWidget(m_statisticsTable);
     
+    statisticsLayout->addWidget(new QLabel("Скользящие окна (последние 1 с / 1 мин / 1 ч):"));
+    m_windowTable = new QTableWidget;
+    m_windowTable->setAlternatingRowColors(true);
+    m_windowTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_windowTable->setWordWrap(false);
+    m_windowTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_windowTable->horizontalHeader()->setStretchLastSection(true);
+    statisticsLayout->addWidget(m_windowTable);
+    
     m_tabWidget->addTab(statisticsWidget, "📈 Статистика");
     
     // Plot Tab (real charts) - Enhanced interactive chart
@@ -420,6 +439,38 @@ void ShiwaDiffPHCMainWindow::onStartMeasurement() {
     }
     
     m_currentConfig = getCurrentConfig();
+    
+    // Устройства открываются один раз на всю сессию измерений
+    std::string error;
+    if (!m_session.open(m_currentConfig, error)) {
+        QMessageBox::warning(this, "Configuration Error", QString::fromStdString(error));
+        return;
+    }
+    
+    QStringList methods;
+    for (size_t i = 0; i < m_session.methods().size(); ++i) {
+        methods << QString("ptp%1=%2").arg(m_currentConfig.devices[i])
+                                      .arg(DiffPHCCore::readMethodName(m_session.methods()[i]));
+    }
+    logMessage(QString("Способ чтения: %1").arg(methods.join(" ")));
+    
+    m_tickResult = PHCResult();
+    m_tickResult.devices = m_currentConfig.devices;
+    m_tickResult.methods = m_session.methods();
+    
+    // История продолжается между запусками с тем же набором устройств
+    if (m_history.devices != m_currentConfig.devices) {
+        m_history = PHCResult();
+        m_history.devices = m_currentConfig.devices;
+        m_history.series.reset(m_currentConfig.devices.size());
+        m_history.series.setLimit(PHC_DEFAULT_HISTORY);
+        m_history.running.reset(m_currentConfig.devices.size());
+        m_windows.reset(m_currentConfig.devices.size());
+    }
+    m_history.methods = m_session.methods();
+    m_history.interval = int64_t(m_currentConfig.delay) * 1000;
+    m_history.success = true;
+    
     m_measuring = true;
     m_currentIteration = 0;
     
@@ -435,8 +486,9 @@ void ShiwaDiffPHCMainWindow::onStartMeasurement() {
     
     m_statusLabel->setText("Measuring...");
     
-    // Start measurement timer
-    m_measurementTimer->start(m_currentConfig.delay / 1000); // Convert μs to ms
+    // Start measurement timer on a fixed deadline grid
+    m_scheduler.start(int64_t(m_currentConfig.delay) * 1000);
+    m_measurementTimer->start(0);
     
     logMessage("Measurement started");
 }
@@ -444,6 +496,7 @@ void ShiwaDiffPHCMainWindow::onStartMeasurement() {
 void ShiwaDiffPHCMainWindow::onStopMeasurement() {
     m_measuring = false;
     m_measurementTimer->stop();
+    m_session.close();
     
     m_startButton->setEnabled(true);
     m_stopButton->setEnabled(false);
@@ -461,20 +514,39 @@ void ShiwaDiffPHCMainWindow::onTimerUpdate() {
     
     logMessage(QString("onTimerUpdate: Starting measurement iteration %1").arg(m_currentIteration + 1));
     
-    // Perform single measurement
-    PHCConfig singleConfig = m_currentConfig;
-    singleConfig.count = 1; // Single measurement
-    
-    logMessage(QString("onTimerUpdate: Config - devices: %1, delay: %2, samples: %3").arg(singleConfig.devices.size()).arg(singleConfig.delay).arg(singleConfig.samples));
-    
-    PHCResult result = DiffPHCCore::measurePHCDifferences(singleConfig);
+    logMessage(QString("onTimerUpdate: Config - devices: %1, delay: %2, samples: %3").arg(m_currentConfig.devices.size()).arg(m_currentConfig.delay).arg(m_currentConfig.samples));
     
-    logMessage(QString("onTimerUpdate: Measurement result - success: %1, differences size: %2, devices size: %3").arg(result.success).arg(result.differences.size()).arg(result.devices.size()));
+    // Perform single measurement on the already opened session, reusing
+    // the tick result buffers instead of building a new PHCResult
+    PHCResult& result = m_tickResult;
+    result.success = m_session.sampleLatest(result, m_scheduler.tick());
+    if (!result.success) {
+        result.error = "PHC session is not open";
+    }
+
+    // Итерация с ошибкой чтения пропускается: нулевое смещение испортило бы статистику
+    if (result.success && !result.series.empty() && !result.series.valid(0)) {
+        for (size_t d = 0; d < result.series.numDevices() && d < result.devices.size(); ++d) {
+            const auto& reading = result.series.reading(0, d);
+            if (!reading.ok()) {
+                logMessage(QString("Read error on PTP%1: %2")
+                           .arg(result.devices[d])
+                           .arg(QString::fromLocal8Bit(strerror(reading.error))));
+            }
+        }
+        m_measurementTimer->start(int((m_scheduler.timeUntilNext() + 999999) / 1000000));
+        return;
+    }
+
+    logMessage(QString("onTimerUpdate: Measurement result - success: %1, offsets size: %2, devices size: %3").arg(result.success).arg(result.series.size()).arg(result.devices.size()));
     
     if (result.success) {
-        m_results.push_back(result);
+        m_history.series.append(result.series, 0);
+        m_history.running.add(result.series.lateness(0), result.series.pairs(0), true);
+        m_windows.append(result.series.timestamp(0), result.series.pairs(0), true);
         updateResultsTable(result);
         updateStatisticsTable(result);
+        updateWindowTable(result);
         logMessage(QString("Calling updatePlot for iteration %1").arg(m_currentIteration));
         updatePlot(result);
         
@@ -493,7 +565,16 @@ void ShiwaDiffPHCMainWindow::onTimerUpdate() {
             }
         }
         
-        logMessage(QString("Iteration %1 completed successfully").arg(m_currentIteration));
+        logMessage(QString("Iteration %1 completed successfully (lateness: %2 μs, missed: %3)")
+                   .arg(m_currentIteration)
+                   .arg(result.series.lateness(result.series.size() - 1) / 1000.0, 0, 'f', 1)
+                   .arg(m_scheduler.missed()));
+        
+        // Перевзвести таймер на следующий дедлайн сетки (QTimer имеет
+        // миллисекундное разрешение, поэтому округляем вверх)
+        if (m_measuring) {
+            m_measurementTimer->start(int((m_scheduler.timeUntilNext() + 999999) / 1000000));
+        }
     } else {
         logMessage(QString("Measurement error: %1").arg(QString::fromStdString(result.error)));
         onStopMeasurement();
@@ -501,7 +582,7 @@ void ShiwaDiffPHCMainWindow::onTimerUpdate() {
 }
 
 void ShiwaDiffPHCMainWindow::updateResultsTable(const PHCResult& result) {
-    if (result.differences.empty()) return;
+    if (result.series.empty()) return;
     
     const auto& devices = result.devices;
     const int numDev = devices.size();
@@ -532,7 +613,7 @@ void ShiwaDiffPHCMainWindow::updateResultsTable(const PHCResult& result) {
     QDateTime timestamp = QDateTime::fromMSecsSinceEpoch(result.baseTimestamp / 1000000);
     m_resultsTable->setItem(row, 1, new QTableWidgetItem(timestamp.toString("hh:mm:ss.zzz")));
     
-    const auto& latest = result.differences.back();
+    const auto latest = result.pairs(result.series.size() - 1);
     for (size_t i = 0; i < latest.size(); ++i) {
         // Форматируем значения в микросекундах для лучшей читаемости
         QString valueStr;
@@ -550,7 +631,8 @@ void ShiwaDiffPHCMainWindow::updateResultsTable(const PHCResult& result) {
 }
 
 void ShiwaDiffPHCMainWindow::updateStatisticsTable(const PHCResult& result) {
-    if (!result.success || m_results.empty()) {
+    const auto& series = m_history.series;
+    if (!result.success || series.empty()) {
         return;
     }
     
@@ -558,7 +640,8 @@ void ShiwaDiffPHCMainWindow::updateStatisticsTable(const PHCResult& result) {
     const int numDev = devices.size();
     
     // Рассчитываем статистику на основе всех накопленных результатов
-    if (m_results.size() < 2) {
+    if (series.size() < 2 || (int)series.numDevices() != numDev ||
+        (int)m_history.running.numDevices != numDev) {
         return; // Нужно минимум 2 измерения для статистики
     }
     
@@ -567,7 +650,7 @@ void ShiwaDiffPHCMainWindow::updateStatisticsTable(const PHCResult& result) {
         QStringList headers;
         headers << "Устройства" << "Медиана" << "Среднее" 
                 << "Мин" << "Макс" << "Размах" 
-                << "Стд.откл" << "Кол-во";
+                << "Стд.откл" << "P99" << "P99.9" << "Кол-во";
         
         m_statisticsTable->setColumnCount(headers.size());
         m_statisticsTable->setHorizontalHeaderLabels(headers);
@@ -583,63 +666,15 @@ void ShiwaDiffPHCMainWindow::updateStatisticsTable(const PHCResult& result) {
         m_statisticsTable->setRowCount(pairCount);
     }
     
-    // Собираем все данные для каждой пары устройств
-    std::vector<std::vector<std::vector<int64_t>>> pairData(numDev);
-    for (int i = 0; i < numDev; ++i) {
-        pairData[i].resize(i + 1);
-    }
-    
-    // Заполняем данные из всех накопленных результатов
-    for (const auto& res : m_results) {
-        if (!res.success || res.differences.empty()) continue;
-        
-        int idx = 0;
-        for (int i = 0; i < numDev; ++i) {
-            for (int j = 0; j <= i; ++j) {
-                if (idx < res.differences[0].size()) {
-                    pairData[i][j].push_back(res.differences[0][idx]);
-                }
-                idx++;
-            }
-        }
-    }
-    
-    // Fill data
+    // Статистика накапливается потоком при каждой итерации, медиана и
+    // процентили - из эскиза квантилей; история заново не просматривается
     int row = 0;
     for (int i = 0; i < numDev; ++i) {
         for (int j = 0; j <= i; ++j) {
             if (i == j) continue; // Skip diagonal
             
-            // Рассчитываем статистику для этой пары устройств
-            const auto& values = pairData[i][j];
-            if (values.empty()) continue;
-            
-            // Сортируем для медианы
-            std::vector<int64_t> sortedValues = values;
-            std::sort(sortedValues.begin(), sortedValues.end());
-            
-            // Рассчитываем статистику
-            double mean = 0;
-            for (int64_t val : values) {
-                mean += val;
-            }
-            mean /= values.size();
-            
-            double median = (values.size() % 2 == 0) 
-                ? (sortedValues[values.size()/2 - 1] + sortedValues[values.size()/2]) / 2.0
-                : sortedValues[values.size()/2];
-            
-            int64_t min = *std::min_element(values.begin(), values.end());
-            int64_t max = *std::max_element(values.begin(), values.end());
-            int64_t range = max - min;
-            
-            // Стандартное отклонение
-            double variance = 0;
-            for (int64_t val : values) {
-                variance += (val - mean) * (val - mean);
-            }
-            variance /= values.size();
-            double stddev = std::sqrt(variance);
+            const PHCStatistics stats = m_history.running.pairStatistics(i, j);
+            if (stats.count == 0) continue;
             
             m_statisticsTable->setItem(row, 0, new QTableWidgetItem(
                 QString("PTP%1-PTP%2").arg(devices[i]).arg(devices[j])));
@@ -653,20 +688,70 @@ void ShiwaDiffPHCMainWindow::updateStatisticsTable(const PHCResult& result) {
                 }
             };
             
-            m_statisticsTable->setItem(row, 1, new QTableWidgetItem(formatValue(median)));
-            m_statisticsTable->setItem(row, 2, new QTableWidgetItem(formatValue(mean)));
-            m_statisticsTable->setItem(row, 3, new QTableWidgetItem(formatValue(min)));
-            m_statisticsTable->setItem(row, 4, new QTableWidgetItem(formatValue(max)));
-            m_statisticsTable->setItem(row, 5, new QTableWidgetItem(formatValue(range)));
-            m_statisticsTable->setItem(row, 6, new QTableWidgetItem(formatValue(stddev)));
-            m_statisticsTable->setItem(row, 7, new QTableWidgetItem(
-                QString::number(values.size())));
+            m_statisticsTable->setItem(row, 1, new QTableWidgetItem(formatValue(stats.median)));
+            m_statisticsTable->setItem(row, 2, new QTableWidgetItem(formatValue(stats.mean)));
+            m_statisticsTable->setItem(row, 3, new QTableWidgetItem(formatValue(stats.minimum)));
+            m_statisticsTable->setItem(row, 4, new QTableWidgetItem(formatValue(stats.maximum)));
+            m_statisticsTable->setItem(row, 5, new QTableWidgetItem(formatValue(stats.range)));
+            m_statisticsTable->setItem(row, 6, new QTableWidgetItem(formatValue(stats.stddev)));
+            m_statisticsTable->setItem(row, 7, new QTableWidgetItem(formatValue(stats.p99)));
+            m_statisticsTable->setItem(row, 8, new QTableWidgetItem(formatValue(stats.p999)));
+            m_statisticsTable->setItem(row, 9, new QTableWidgetItem(
+                QString::number(stats.count)));
             
             row++;
         }
     }
 }
 
+void ShiwaDiffPHCMainWindow::updateWindowTable(const PHCResult& result) {
+    const auto& devices = result.devices;
+    const int numDev = devices.size();
+    if (!result.success || numDev < 2 || (int)m_windows.numDevices() != numDev) {
+        return;
+    }
+    
+    if (m_windowTable->columnCount() == 0) {
+        QStringList headers;
+        headers << "Устройства" << "Окно" << "Среднее" << "Мин" << "Макс"
+                << "Размах" << "Стд.откл" << "Кол-во";
+        m_windowTable->setColumnCount(headers.size());
+        m_windowTable->setHorizontalHeaderLabels(headers);
+        m_windowTable->setRowCount(numDev * (numDev - 1) / 2 * m_windows.windowCount());
+    }
+    
+    auto formatValue = [](double value) -> QString {
+        if (std::abs(value) >= 1000) {
+            return QString("%1 μс").arg(value / 1000.0, 0, 'f', 1);
+        } else {
+            return QString("%1 нс").arg(value, 0, 'f', 1);
+        }
+    };
+    
+    // Окна обновляются каждой итерацией за O(1), таблица только читает их
+    int row = 0;
+    for (int i = 1; i < numDev; ++i) {
+        for (int j = 0; j < i; ++j) {
+            for (size_t w = 0; w < m_windows.windowCount(); ++w, ++row) {
+                const PHCRunningStats stats = m_windows.statistics(w, i, j);
+                const int64_t seconds = m_windows.width(w) / 1000000000LL;
+                const QString width = seconds % 3600 == 0 ? QString("%1 ч").arg(seconds / 3600)
+                                    : seconds % 60 == 0 ? QString("%1 мин").arg(seconds / 60)
+                                    : QString("%1 с").arg(seconds);
+                m_windowTable->setItem(row, 0, new QTableWidgetItem(
+                    QString("PTP%1-PTP%2").arg(devices[i]).arg(devices[j])));
+                m_windowTable->setItem(row, 1, new QTableWidgetItem(width));
+                m_windowTable->setItem(row, 2, new QTableWidgetItem(formatValue(stats.mean)));
+                m_windowTable->setItem(row, 3, new QTableWidgetItem(formatValue(stats.minimum)));
+                m_windowTable->setItem(row, 4, new QTableWidgetItem(formatValue(stats.maximum)));
+                m_windowTable->setItem(row, 5, new QTableWidgetItem(formatValue(stats.range())));
+                m_windowTable->setItem(row, 6, new QTableWidgetItem(formatValue(stats.stddev())));
+                m_windowTable->setItem(row, 7, new QTableWidgetItem(QString::number(stats.count)));
+            }
+        }
+    }
+}
+
 void ShiwaDiffPHCMainWindow::onDeviceSelectionChanged() {
     // Update device count and enable/disable start button
     int selectedCount = 0;
@@ -731,11 +816,15 @@ PHCConfig ShiwaDiffPHCMainWindow::getCurrentConfig() {
 }
 
 void ShiwaDiffPHCMainWindow::clearResults() {
-    m_results.clear();
+    m_history.series.clear();
+    m_history.running.reset(m_history.series.numDevices());
+    m_windows.reset(m_history.series.numDevices());
     m_resultsTable->setRowCount(0);
     m_resultsTable->setColumnCount(0);
     m_statisticsTable->setRowCount(0);
     m_statisticsTable->setColumnCount(0);
+    m_windowTable->setRowCount(0);
+    m_windowTable->setColumnCount(0);
     m_currentIteration = 0;
     logMessage("Результаты очищены");
 }
@@ -746,7 +835,7 @@ void ShiwaDiffPHCMainWindow::logMessage(const QString& message) {
 }
 
 void ShiwaDiffPHCMainWindow::onSaveResults() {
-    if (m_results.empty()) {
+    if (m_history.series.empty()) {
         QMessageBox::information(this, "No Data", "No measurement results to save.");
         return;
     }
@@ -754,10 +843,20 @@ void ShiwaDiffPHCMainWindow::onSaveResults() {
     QString fileName = QFileDialog::getSaveFileName(this, "Save Results", 
                                                    QString("diffphc_results_%1.csv")
                                                    .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss")),
-                                                   "CSV Files (*.csv);;JSON Files (*.json)");
+                                                   "CSV Files (*.csv);;JSON Files (*.json);;PHC Recording (*.phcrec)");
     
     if (fileName.isEmpty()) return;
     
+    if (fileName.endsWith(".phcrec")) {
+        std::string error;
+        if (!PHCRecordingWriter::writeResult(fileName.toStdString(), m_currentConfig, m_history, error)) {
+            QMessageBox::warning(this, "Save Error", QString::fromStdString(error));
+            return;
+        }
+        logMessage(QString("Recording of %1 iterations saved to %2").arg(m_history.series.size()).arg(fileName));
+        return;
+    }
+    
     // Save implementation would go here
     logMessage(QString("Results saved to %1").arg(fileName));
 }
@@ -789,7 +888,7 @@ void ShiwaDiffPHCMainWindow::onRefreshDevices() {
 
 void ShiwaDiffPHCMainWindow::updatePlot(const PHCResult& result) {
     // Добавляем отладочную информацию
-    logMessage(QString("updatePlot called - success: %1, differences size: %2").arg(result.success).arg(result.differences.size()));
+    logMessage(QString("updatePlot called - success: %1, offsets size: %2").arg(result.success).arg(result.series.size()));
     
     // Получаем существующий график или создаем новый
     QChart* chart = m_plotWidget->chart();
@@ -839,20 +938,18 @@ void ShiwaDiffPHCMainWindow::updatePlot(const PHCResult& result) {
         }
     }
 
-    if (result.success && !result.differences.empty()) {
+    if (result.success && !result.series.empty()) {
         logMessage(QString("updatePlot: Creating chart with %1 devices").arg(result.devices.size()));
         
         // Check for unsynchronized devices
         bool hasUnsyncDevices = false;
-        for (size_t i = 0; i < result.devices.size(); ++i) {
-            for (size_t j = i + 1; j < result.devices.size(); ++j) {
-                size_t idx = i * result.devices.size() + j;
-                if (idx < result.differences[0].size()) {
-                    qint64 value = result.differences[0][idx];
-                    if (std::abs(value) > 1000000000LL) { // More than 1 second
-                        hasUnsyncDevices = true;
-                        logMessage(QString("⚠️ PTP Device %1 may be unsynchronized (difference: %2 ns)").arg(result.devices[i]).arg(value));
-                    }
+        const auto firstPairs = result.pairs(0);
+        for (size_t i = 0; i < firstPairs.numDevices(); ++i) {
+            for (size_t j = i + 1; j < firstPairs.numDevices(); ++j) {
+                qint64 value = firstPairs(i, j);
+                if (std::abs(value) > 1000000000LL) { // More than 1 second
+                    hasUnsyncDevices = true;
+                    logMessage(QString("⚠️ PTP Device %1 may be unsynchronized (difference: %2 ns)").arg(result.devices[i]).arg(value));
                 }
             }
         }
@@ -898,12 +995,11 @@ void ShiwaDiffPHCMainWindow::updatePlot(const PHCResult& result) {
                 }
                 
                 // Добавляем новую точку к существующей серии
-                if (!result.differences.empty()) {
-                    const auto& latestMeasurement = result.differences.back();
-                    size_t idx = i * devices.size() + j;
-                    if (idx < latestMeasurement.size()) {
+                if (!result.series.empty()) {
+                    const auto latestMeasurement = result.pairs(result.series.size() - 1);
+                    if (j < latestMeasurement.numDevices()) {
                         QDateTime pointTime = QDateTime::currentDateTime();
-                        qint64 value = latestMeasurement[idx];
+                        qint64 value = latestMeasurement(i, j);
                         
                         // Filter out unreasonable values (more than 1 second difference)
                         const int64_t MAX_REASONABLE_DIFF_NS = 1000000000LL; // 1 second in nanoseconds
@@ -1168,7 +1264,7 @@ void ShiwaDiffPHCMainWindow::dropEvent(QDropEvent* event) {
 }
 
 void ShiwaDiffPHCMainWindow::onAdvancedAnalysis() {
-    if (m_results.empty()) {
+    if (m_history.series.empty()) {
         QMessageBox::information(this, "Расширенный анализ", 
                                "Нет данных для анализа. Сначала выполните измерения.");
         return;
@@ -1180,8 +1276,8 @@ void ShiwaDiffPHCMainWindow::onAdvancedAnalysis() {
     progress.show();
     QApplication::processEvents();
     
-    // Perform comprehensive analysis on the latest result
-    const PHCResult& latestResult = m_results.back();
+    // Perform comprehensive analysis on the measurement history
+    const PHCResult& latestResult = m_history;
     logMessage("Выполняется расширенный анализ...");
     
     progress.setValue(20);
@@ -1312,6 +1408,95 @@ void ShiwaDiffPHCMainWindow::onAnomalyDetection() {
     QMessageBox::information(this, "Детекция аномалий", anomalyText);
 }
 
+void ShiwaDiffPHCMainWindow::onStabilityAnalysis() {
+    // Кривая строится по текущей истории при каждом вызове: результат
+    // расширенного анализа устаревает с первой новой итерацией
+    const StabilityAnalysis stability = AdvancedAnalysis::analyzeStability(m_history);
+    if (stability.taus.empty()) {
+        QMessageBox::information(this, "Стабильность",
+                               "Недостаточно данных: нужно не менее 3 итераций и 2 устройств.");
+        return;
+    }
+    
+    QString stabilityText = QString(
+        "⏱ СТАБИЛЬНОСТЬ %1\n\n"
+        "Шаг данных τ0: %2 с\n\n"
+        "τ, с\tADEV\tMDEV\tTDEV, нс\n"
+    ).arg(QString::fromStdString(stability.pair))
+     .arg(stability.tau0, 0, 'g', 4);
+    for (size_t k = 0; k < stability.taus.size(); ++k) {
+        stabilityText += QString("%1\t%2\t%3\t%4\n")
+            .arg(stability.taus[k], 0, 'g', 4)
+            .arg(stability.adev[k], 0, 'e', 3)
+            .arg(stability.mdev[k], 0, 'e', 3)
+            .arg(stability.tdev[k], 0, 'f', 1);
+    }
+    if (stability.gaps > 0) {
+        stabilityText += QString("\nРазрывов фазы: %1, оценки по отрезкам без разрывов").arg(stability.gaps);
+    }
+    
+    QMessageBox::information(this, "Стабильность", stabilityText);
+}
+
+void ShiwaDiffPHCMainWindow::onMtieAnalysis() {
+    if (m_history.series.size() < 2) {
+        QMessageBox::information(this, "MTIE",
+                               "Нет данных для анализа. Сначала выполните измерения.");
+        return;
+    }
+    
+    bool ok = false;
+    QString mask = QInputDialog::getText(this, "MTIE",
+                                         "Маска TAU:NS через запятую (пусто - без проверки):",
+                                         QLineEdit::Normal, m_mtieMask, &ok);
+    if (!ok) {
+        return;
+    }
+    
+    MtieAnalysis mtie;
+    std::string error;
+    if (!AdvancedAnalysis::analyzeMTIE(m_history, mask.trimmed().toStdString(), mtie, error)) {
+        QMessageBox::warning(this, "MTIE", QString::fromStdString(error));
+        return;
+    }
+    m_mtieMask = mask.trimmed();
+    m_advancedStats.mtie = mtie;
+    if (mtie.taus.empty()) {
+        QMessageBox::information(this, "MTIE",
+                               "Недостаточно данных: нужно не менее 2 итераций и 2 устройств.");
+        return;
+    }
+    
+    QString mtieText = QString(
+        "📏 MTIE %1\n\n"
+        "Шаг данных τ0: %2 с\n\n"
+        "τ, с\tMTIE, нс\tПредел, нс\n"
+    ).arg(QString::fromStdString(mtie.pair))
+     .arg(mtie.tau0, 0, 'g', 4);
+    for (size_t k = 0; k < mtie.taus.size(); ++k) {
+        const bool exceeded = mtie.limits[k] > 0 && mtie.mtie[k] > mtie.limits[k];
+        mtieText += QString("%1\t%2\t%3%4\n")
+            .arg(mtie.taus[k], 0, 'g', 4)
+            .arg(mtie.mtie[k])
+            .arg(mtie.limits[k] > 0 ? QString::number(mtie.limits[k], 'f', 1) : QString("-"))
+            .arg(exceeded ? " ❌" : "");
+    }
+    if (mtie.gaps > 0) {
+        mtieText += QString("\nРазрывов фазы: %1, окна только внутри отрезков без разрывов").arg(mtie.gaps);
+    }
+    if (!mtie.mask.empty()) {
+        if (!mtie.checked) {
+            mtieText += "\n❌ Маска НЕ проверена: нет интервалов τ в ее пределах";
+        } else {
+            mtieText += mtie.passed ? "\n✅ Маска пройдена" : "\n❌ Маска НЕ пройдена";
+        }
+    }
+    
+    QMessageBox::information(this, "MTIE", mtieText);
+    logMessage(QString("MTIE %1: %2").arg(QString::fromStdString(mtie.pair))
+               .arg(mtie.mask.empty() ? "без маски" : (mtie.passed ? "маска пройдена" : "маска не пройдена")));
+}
+
 void ShiwaDiffPHCMainWindow::onGenerateReport() {
     if (!m_hasAdvancedStats) {
         QMessageBox::information(this, "Генерация отчета", 
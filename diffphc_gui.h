@@ -40,6 +40,8 @@
 #include <vector>
 
 #include "diffphc_core.h"
+#include "diffphc_recording.h"
+#include "diffphc_rollup.h"
 #include "advanced_analysis.h"
 #include "web_server_alternative.h"
 
@@ -73,6 +75,8 @@ private slots:
     void onTrendAnalysis();
     void onSpectralAnalysis();
     void onAnomalyDetection();
+    void onStabilityAnalysis();
+    void onMtieAnalysis();
     void onGenerateReport();
     
     // PTP Synchronization slots
@@ -95,6 +99,7 @@ private:
     void updateDeviceList();
     void updateResultsTable(const PHCResult& result);
     void updateStatisticsTable(const PHCResult& result);
+    void updateWindowTable(const PHCResult& result);
     void updatePlot(const PHCResult& result);
     void logMessage(const QString& message);
     bool validateConfiguration();
@@ -143,6 +148,7 @@ private:
     // Results Panel
     QTableWidget* m_resultsTable;
     QTableWidget* m_statisticsTable;
+    QTableWidget* m_windowTable;        // Скользящие окна 1 с / 1 мин / 1 ч
     QChartView* m_plotWidget; // Real chart widget
     QPlainTextEdit* m_logTextEdit;
     
@@ -154,7 +160,11 @@ private:
     // Measurement state
     QTimer* m_measurementTimer;
     PHCConfig m_currentConfig;
-    std::vector<PHCResult> m_results;
+    PHCSession m_session;
+    PHCScheduler m_scheduler;
+    PHCResult m_tickResult;     // Переиспользуемый результат одной итерации
+    PHCResult m_history;        // Последние итерации в кольце ограниченной емкости
+    PHCSlidingStats m_windows;  // Статистика пар за последние 1 с / 1 мин / 1 ч
     bool m_measuring;
     int m_currentIteration;
     std::vector<int> m_availableDevices;
@@ -167,6 +177,7 @@ private:
     // Advanced analysis
     AdvancedStatistics m_advancedStats;
     bool m_hasAdvancedStats;
+    QString m_mtieMask;             // Последняя маска MTIE (TAU:NS,...)
     
     // PTP Synchronization
     QProcess* m_syncProcess;
@@ -0,0 +1,527 @@
+#include "diffphc_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Сумма с компенсацией Ноймайера: потерянные при сложении младшие разряды
+// копятся отдельно, в том числе когда слагаемое больше текущей суммы
+struct NeumaierSum {
+    double sum = 0.0;
+    double compensation = 0.0;
+
+    void add(double x) {
+        const double t = sum + x;
+        if (std::abs(sum) >= std::abs(x)) {
+            compensation += (sum - t) + x;
+        } else {
+            compensation += (x - t) + sum;
+        }
+        sum = t;
+    }
+    double result() const { return sum + compensation; }
+};
+
+// Scalar kernels
+double sumScalar(const int64_t* values, size_t n, int64_t ref) {
+    NeumaierSum acc;
+    for (size_t i = 0; i < n; ++i) {
+        acc.add(double(values[i] - ref));
+    }
+    return acc.result();
+}
+
+double sumSquaresScalar(const int64_t* values, size_t n, int64_t ref, double offset) {
+    double acc = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        const double d = double(values[i] - ref) - offset;
+        acc += d * d;
+    }
+    return acc;
+}
+
+void minmaxScalar(const int64_t* values, size_t n, int64_t& minimum, int64_t& maximum) {
+    minimum = maximum = values[0];
+    for (size_t i = 1; i < n; ++i) {
+        minimum = std::min(minimum, values[i]);
+        maximum = std::max(maximum, values[i]);
+    }
+}
+
+void toDoubleScalar(const int64_t* values, size_t n, double* out) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = double(values[i]);
+    }
+}
+
+double sumDoubleScalar(const double* values, size_t n) {
+    NeumaierSum acc;
+    for (size_t i = 0; i < n; ++i) {
+        acc.add(values[i]);
+    }
+    return acc.result();
+}
+
+double sumSquaresDoubleScalar(const double* values, size_t n, double center) {
+    double acc = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        const double d = values[i] - center;
+        acc += d * d;
+    }
+    return acc;
+}
+
+#if defined(__x86_64__)
+
+// AVX2 kernels
+
+// int64 -> double на всем диапазоне: старшие 48 и младшие 16 бит
+// переводятся через мантиссу отдельно, единственное округление - при
+// итоговом сложении (в AVX2 нет vcvtqq2pd)
+__attribute__((target("avx2")))
+inline __m256d toDoubleAVX2(__m256i x) {
+    __m256i high = _mm256_srai_epi32(x, 16);
+    high = _mm256_blend_epi16(high, _mm256_setzero_si256(), 0x33);
+    high = _mm256_add_epi64(high, _mm256_castpd_si256(_mm256_set1_pd(442721857769029238784.0)));    // 3·2^67
+    const __m256i low = _mm256_blend_epi16(x, _mm256_castpd_si256(_mm256_set1_pd(4503599627370496.0)), 0x88);  // 2^52
+    const __m256d f = _mm256_sub_pd(_mm256_castsi256_pd(high), _mm256_set1_pd(442726361368656609280.0));   // 3·2^67 + 2^52
+    return _mm256_add_pd(f, _mm256_castsi256_pd(low));
+}
+
+// Шаг Ноймайера в каждой полосе
+__attribute__((target("avx2")))
+inline void neumaierAVX2(__m256d& sum, __m256d& compensation, __m256d x) {
+    const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    const __m256d t = _mm256_add_pd(sum, x);
+    const __m256d sumLarger = _mm256_cmp_pd(_mm256_and_pd(sum, absMask), _mm256_and_pd(x, absMask), _CMP_GE_OQ);
+    const __m256d large = _mm256_blendv_pd(x, sum, sumLarger);
+    const __m256d small = _mm256_blendv_pd(sum, x, sumLarger);
+    compensation = _mm256_add_pd(compensation, _mm256_add_pd(_mm256_sub_pd(large, t), small));
+    sum = t;
+}
+
+__attribute__((target("avx2")))
+inline void drainAVX2(NeumaierSum& acc, __m256d sum, __m256d compensation) {
+    alignas(32) double lanes[8];
+    _mm256_store_pd(lanes, sum);
+    _mm256_store_pd(lanes + 4, compensation);
+    for (double lane : lanes) {
+        acc.add(lane);
+    }
+}
+
+__attribute__((target("avx2")))
+inline double horizontalAVX2(__m256d x) {
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, x);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx2")))
+double sumAVX2(const int64_t* values, size_t n, int64_t ref) {
+    const __m256i base = _mm256_set1_epi64x(ref);
+    __m256d s0 = _mm256_setzero_pd(), c0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd(), c1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        const __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 4));
+        neumaierAVX2(s0, c0, toDoubleAVX2(_mm256_sub_epi64(x0, base)));
+        neumaierAVX2(s1, c1, toDoubleAVX2(_mm256_sub_epi64(x1, base)));
+    }
+    NeumaierSum acc;
+    drainAVX2(acc, s0, c0);
+    drainAVX2(acc, s1, c1);
+    for (; i < n; ++i) {
+        acc.add(double(values[i] - ref));
+    }
+    return acc.result();
+}
+
+__attribute__((target("avx2")))
+double sumSquaresAVX2(const int64_t* values, size_t n, int64_t ref, double offset) {
+    const __m256i base = _mm256_set1_epi64x(ref);
+    const __m256d shift = _mm256_set1_pd(offset);
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        const __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 4));
+        const __m256d d0 = _mm256_sub_pd(toDoubleAVX2(_mm256_sub_epi64(x0, base)), shift);
+        const __m256d d1 = _mm256_sub_pd(toDoubleAVX2(_mm256_sub_epi64(x1, base)), shift);
+        a0 = _mm256_add_pd(a0, _mm256_mul_pd(d0, d0));
+        a1 = _mm256_add_pd(a1, _mm256_mul_pd(d1, d1));
+    }
+    double acc = horizontalAVX2(_mm256_add_pd(a0, a1));
+    for (; i < n; ++i) {
+        const double d = double(values[i] - ref) - offset;
+        acc += d * d;
+    }
+    return acc;
+}
+
+__attribute__((target("avx2")))
+void minmaxAVX2(const int64_t* values, size_t n, int64_t& minimum, int64_t& maximum) {
+    __m256i lo = _mm256_set1_epi64x(values[0]);
+    __m256i hi = lo;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        lo = _mm256_blendv_epi8(lo, x, _mm256_cmpgt_epi64(lo, x));
+        hi = _mm256_blendv_epi8(hi, x, _mm256_cmpgt_epi64(x, hi));
+    }
+    alignas(32) int64_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), lo);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes + 4), hi);
+    minimum = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    maximum = std::max(std::max(lanes[4], lanes[5]), std::max(lanes[6], lanes[7]));
+    for (; i < n; ++i) {
+        minimum = std::min(minimum, values[i]);
+        maximum = std::max(maximum, values[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+void toDoubleAVX2(const int64_t* values, size_t n, double* out) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        _mm256_storeu_pd(out + i, toDoubleAVX2(x));
+    }
+    for (; i < n; ++i) {
+        out[i] = double(values[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+double sumDoubleAVX2(const double* values, size_t n) {
+    __m256d s0 = _mm256_setzero_pd(), c0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd(), c1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        neumaierAVX2(s0, c0, _mm256_loadu_pd(values + i));
+        neumaierAVX2(s1, c1, _mm256_loadu_pd(values + i + 4));
+    }
+    NeumaierSum acc;
+    drainAVX2(acc, s0, c0);
+    drainAVX2(acc, s1, c1);
+    for (; i < n; ++i) {
+        acc.add(values[i]);
+    }
+    return acc.result();
+}
+
+__attribute__((target("avx2")))
+double sumSquaresDoubleAVX2(const double* values, size_t n, double center) {
+    const __m256d shift = _mm256_set1_pd(center);
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(values + i), shift);
+        const __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(values + i + 4), shift);
+        a0 = _mm256_add_pd(a0, _mm256_mul_pd(d0, d0));
+        a1 = _mm256_add_pd(a1, _mm256_mul_pd(d1, d1));
+    }
+    double acc = horizontalAVX2(_mm256_add_pd(a0, a1));
+    for (; i < n; ++i) {
+        const double d = values[i] - center;
+        acc += d * d;
+    }
+    return acc;
+}
+
+// AVX-512 kernels
+
+__attribute__((target("avx512f,avx512dq")))
+inline void neumaierAVX512(__m512d& sum, __m512d& compensation, __m512d x) {
+    const __m512d t = _mm512_add_pd(sum, x);
+    const __mmask8 sumLarger = _mm512_cmp_pd_mask(_mm512_abs_pd(sum), _mm512_abs_pd(x), _CMP_GE_OQ);
+    const __m512d large = _mm512_mask_blend_pd(sumLarger, x, sum);
+    const __m512d small = _mm512_mask_blend_pd(sumLarger, sum, x);
+    compensation = _mm512_add_pd(compensation, _mm512_add_pd(_mm512_sub_pd(large, t), small));
+    sum = t;
+}
+
+__attribute__((target("avx512f,avx512dq")))
+inline void drainAVX512(NeumaierSum& acc, __m512d sum, __m512d compensation) {
+    alignas(64) double lanes[16];
+    _mm512_store_pd(lanes, sum);
+    _mm512_store_pd(lanes + 8, compensation);
+    for (double lane : lanes) {
+        acc.add(lane);
+    }
+}
+
+// Горизонтальная сумма через память: встроенные _mm512_reduce_* в GCC 12
+// дают ложные предупреждения -Wuninitialized
+__attribute__((target("avx512f,avx512dq")))
+inline double horizontalAVX512(__m512d x) {
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, x);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+__attribute__((target("avx512f,avx512dq")))
+double sumAVX512(const int64_t* values, size_t n, int64_t ref) {
+    const __m512i base = _mm512_set1_epi64(ref);
+    __m512d s0 = _mm512_setzero_pd(), c0 = _mm512_setzero_pd();
+    __m512d s1 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m512i x0 = _mm512_loadu_si512(values + i);
+        const __m512i x1 = _mm512_loadu_si512(values + i + 8);
+        neumaierAVX512(s0, c0, _mm512_cvtepi64_pd(_mm512_sub_epi64(x0, base)));
+        neumaierAVX512(s1, c1, _mm512_cvtepi64_pd(_mm512_sub_epi64(x1, base)));
+    }
+    NeumaierSum acc;
+    drainAVX512(acc, s0, c0);
+    drainAVX512(acc, s1, c1);
+    for (; i < n; ++i) {
+        acc.add(double(values[i] - ref));
+    }
+    return acc.result();
+}
+
+__attribute__((target("avx512f,avx512dq")))
+double sumSquaresAVX512(const int64_t* values, size_t n, int64_t ref, double offset) {
+    const __m512i base = _mm512_set1_epi64(ref);
+    const __m512d shift = _mm512_set1_pd(offset);
+    __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m512i x0 = _mm512_loadu_si512(values + i);
+        const __m512i x1 = _mm512_loadu_si512(values + i + 8);
+        const __m512d d0 = _mm512_sub_pd(_mm512_cvtepi64_pd(_mm512_sub_epi64(x0, base)), shift);
+        const __m512d d1 = _mm512_sub_pd(_mm512_cvtepi64_pd(_mm512_sub_epi64(x1, base)), shift);
+        a0 = _mm512_add_pd(a0, _mm512_mul_pd(d0, d0));
+        a1 = _mm512_add_pd(a1, _mm512_mul_pd(d1, d1));
+    }
+    double acc = horizontalAVX512(_mm512_add_pd(a0, a1));
+    for (; i < n; ++i) {
+        const double d = double(values[i] - ref) - offset;
+        acc += d * d;
+    }
+    return acc;
+}
+
+__attribute__((target("avx512f,avx512dq")))
+void minmaxAVX512(const int64_t* values, size_t n, int64_t& minimum, int64_t& maximum) {
+    __m512i lo = _mm512_set1_epi64(values[0]);
+    __m512i hi = lo;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m512i x = _mm512_loadu_si512(values + i);
+        lo = _mm512_mask_min_epi64(lo, 0xFF, lo, x);     // Не _mm512_min_epi64: то же предупреждение
+        hi = _mm512_mask_max_epi64(hi, 0xFF, hi, x);
+    }
+    alignas(64) int64_t lanes[16];
+    _mm512_store_si512(lanes, lo);
+    _mm512_store_si512(lanes + 8, hi);
+    minimum = *std::min_element(lanes, lanes + 8);
+    maximum = *std::max_element(lanes + 8, lanes + 16);
+    for (; i < n; ++i) {
+        minimum = std::min(minimum, values[i]);
+        maximum = std::max(maximum, values[i]);
+    }
+}
+
+__attribute__((target("avx512f,avx512dq")))
+void toDoubleAVX512(const int64_t* values, size_t n, double* out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(out + i, _mm512_cvtepi64_pd(_mm512_loadu_si512(values + i)));
+    }
+    for (; i < n; ++i) {
+        out[i] = double(values[i]);
+    }
+}
+
+__attribute__((target("avx512f,avx512dq")))
+double sumDoubleAVX512(const double* values, size_t n) {
+    __m512d s0 = _mm512_setzero_pd(), c0 = _mm512_setzero_pd();
+    __m512d s1 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        neumaierAVX512(s0, c0, _mm512_loadu_pd(values + i));
+        neumaierAVX512(s1, c1, _mm512_loadu_pd(values + i + 8));
+    }
+    NeumaierSum acc;
+    drainAVX512(acc, s0, c0);
+    drainAVX512(acc, s1, c1);
+    for (; i < n; ++i) {
+        acc.add(values[i]);
+    }
+    return acc.result();
+}
+
+__attribute__((target("avx512f,avx512dq")))
+double sumSquaresDoubleAVX512(const double* values, size_t n, double center) {
+    const __m512d shift = _mm512_set1_pd(center);
+    __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(values + i), shift);
+        const __m512d d1 = _mm512_sub_pd(_mm512_loadu_pd(values + i + 8), shift);
+        a0 = _mm512_add_pd(a0, _mm512_mul_pd(d0, d0));
+        a1 = _mm512_add_pd(a1, _mm512_mul_pd(d1, d1));
+    }
+    double acc = horizontalAVX512(_mm512_add_pd(a0, a1));
+    for (; i < n; ++i) {
+        const double d = values[i] - center;
+        acc += d * d;
+    }
+    return acc;
+}
+
+#endif // __x86_64__
+
+struct KernelTable {
+    double (*sum)(const int64_t*, size_t, int64_t);
+    double (*sumSquares)(const int64_t*, size_t, int64_t, double);
+    void (*minmax)(const int64_t*, size_t, int64_t&, int64_t&);
+    void (*toDouble)(const int64_t*, size_t, double*);
+    double (*sumDouble)(const double*, size_t);
+    double (*sumSquaresDouble)(const double*, size_t, double);
+};
+
+// По PHCKernelIsa; без x86-64 все наборы - скалярные
+const KernelTable KERNELS[int(PHCKernelIsa::Count)] = {
+    {sumScalar, sumSquaresScalar, minmaxScalar, toDoubleScalar, sumDoubleScalar, sumSquaresDoubleScalar},
+#if defined(__x86_64__)
+    {sumAVX2, sumSquaresAVX2, minmaxAVX2, toDoubleAVX2, sumDoubleAVX2, sumSquaresDoubleAVX2},
+    {sumAVX512, sumSquaresAVX512, minmaxAVX512, toDoubleAVX512, sumDoubleAVX512, sumSquaresDoubleAVX512},
+#else
+    {sumScalar, sumSquaresScalar, minmaxScalar, toDoubleScalar, sumDoubleScalar, sumSquaresDoubleScalar},
+    {sumScalar, sumSquaresScalar, minmaxScalar, toDoubleScalar, sumDoubleScalar, sumSquaresDoubleScalar},
+#endif
+};
+
+PHCKernelIsa selectIsa() {
+    for (int isa = int(PHCKernelIsa::Count) - 1; isa > 0; --isa) {
+        if (PHCKernels::supported(PHCKernelIsa(isa))) {
+            return PHCKernelIsa(isa);
+        }
+    }
+    return PHCKernelIsa::Scalar;
+}
+
+const KernelTable& active() {
+    static const KernelTable& table = KERNELS[int(PHCKernels::isa())];
+    return table;
+}
+
+} // namespace
+
+// PHCKernels implementation
+PHCKernelIsa PHCKernels::isa() {
+    static const PHCKernelIsa selected = selectIsa();
+    return selected;
+}
+
+bool PHCKernels::supported(PHCKernelIsa isa) {
+    switch (isa) {
+        case PHCKernelIsa::Scalar:
+            return true;
+#if defined(__x86_64__)
+        case PHCKernelIsa::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+        case PHCKernelIsa::AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* PHCKernels::isaName(PHCKernelIsa isa) {
+    switch (isa) {
+        case PHCKernelIsa::Scalar: return "scalar";
+        case PHCKernelIsa::AVX2: return "avx2";
+        case PHCKernelIsa::AVX512: return "avx512";
+        default: return "unknown";
+    }
+}
+
+double PHCKernels::sum(const int64_t* values, size_t n, int64_t ref) {
+    return active().sum(values, n, ref);
+}
+
+double PHCKernels::sumSquares(const int64_t* values, size_t n, int64_t ref, double offset) {
+    return active().sumSquares(values, n, ref, offset);
+}
+
+void PHCKernels::minmax(const int64_t* values, size_t n, int64_t& minimum, int64_t& maximum) {
+    active().minmax(values, n, minimum, maximum);
+}
+
+void PHCKernels::toDouble(const int64_t* values, size_t n, double* out) {
+    active().toDouble(values, n, out);
+}
+
+double PHCKernels::sum(const double* values, size_t n) {
+    return active().sumDouble(values, n);
+}
+
+double PHCKernels::sumSquares(const double* values, size_t n, double center) {
+    return active().sumSquaresDouble(values, n, center);
+}
+
+std::vector<PHCKernelBenchmark> PHCKernels::benchmark(size_t values, int repeats) {
+    // Столбец, похожий на разность пары PHC: абсолютное смещение, медленный
+    // уход и шум чтения
+    std::vector<int64_t> data(std::max<size_t>(values, 1));
+    std::mt19937_64 rng(1);
+    const int64_t ref = 1700000000000000000LL;
+    __int128 exact = 0;
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = ref + int64_t(i) * 37 + int64_t(rng() % 2001) - 1000;
+        exact += data[i] - ref;
+    }
+    std::vector<double> converted(data.size());
+    const size_t n = data.size();
+
+    auto best = [&](auto&& body) {
+        double result = std::numeric_limits<double>::infinity();
+        for (int r = 0; r < std::max(1, repeats); ++r) {
+            const auto start = std::chrono::steady_clock::now();
+            body();
+            const auto stop = std::chrono::steady_clock::now();
+            result = std::min(result, std::chrono::duration<double, std::nano>(stop - start).count() / n);
+        }
+        return result;
+    };
+
+    std::vector<PHCKernelBenchmark> results;
+    for (int k = 0; k < int(PHCKernelIsa::Count); ++k) {
+        const auto isa = PHCKernelIsa(k);
+        if (!supported(isa)) {
+            continue;
+        }
+        const auto& kernels = KERNELS[k];
+        PHCKernelBenchmark b;
+        b.isa = isa;
+        volatile double sink = 0.0;
+        double total = 0.0;
+        b.sumNs = best([&] { sink = total = kernels.sum(data.data(), n, ref); });
+        const double offset = total / n;
+        b.sumSquaresNs = best([&] { sink = kernels.sumSquares(data.data(), n, ref, offset); });
+        b.minmaxNs = best([&] {
+            int64_t minimum, maximum;
+            kernels.minmax(data.data(), n, minimum, maximum);
+            sink = double(maximum - minimum);
+        });
+        b.toDoubleNs = best([&] { kernels.toDouble(data.data(), n, converted.data()); });
+        b.sumError = std::abs(total - double(exact)) / std::max(1.0, std::abs(double(exact)));
+        (void)sink;
+        results.push_back(b);
+    }
+    return results;
+}
@@ -0,0 +1,60 @@
+#ifndef DIFFPHC_KERNELS_H
+#define DIFFPHC_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Набор команд векторных ядер
+enum class PHCKernelIsa {
+    Scalar = 0,     // Переносимые циклы
+    AVX2,           // 4 значения int64 за команду
+    AVX512,         // 8 значений, AVX-512F + DQ (vcvtqq2pd)
+    Count
+};
+
+// Время ядер одного набора команд, нс на значение
+struct PHCKernelBenchmark {
+    PHCKernelIsa isa;
+    double sumNs;
+    double sumSquaresNs;
+    double minmaxNs;
+    double toDoubleNs;
+    double sumError;            // Относительная ошибка суммы по точной целой сумме
+};
+
+// Векторные ядра для столбцов int64: сумма, сумма квадратов отклонений,
+// минимум/максимум и преобразование в double. Реализации - скалярная,
+// AVX2 и AVX-512; нужная выбирается один раз при первом вызове по
+// возможностям процессора, поэтому один двоичный файл работает на любом
+// x86-64 и использует самый широкий доступный набор команд.
+//
+// Значения суммируются относительно опорного ref: разность x - ref точна
+// в int64 и мала по сравнению с абсолютными метками PHC, поэтому переводится
+// в double без потерь. Сумма - с компенсацией Ноймайера в каждой полосе
+// вектора: ошибка не растет с числом значений и для миллиардов значений
+// остается на уровне округления результата.
+class PHCKernels {
+public:
+    // Набор команд, выбранный при запуске
+    static PHCKernelIsa isa();
+    static bool supported(PHCKernelIsa isa);
+    static const char* isaName(PHCKernelIsa isa);
+
+    // Σ (x - ref) с компенсацией
+    static double sum(const int64_t* values, size_t n, int64_t ref);
+    // Σ ((x - ref) - offset)²
+    static double sumSquares(const int64_t* values, size_t n, int64_t ref, double offset);
+    // Минимум и максимум; n > 0
+    static void minmax(const int64_t* values, size_t n, int64_t& minimum, int64_t& maximum);
+    static void toDouble(const int64_t* values, size_t n, double* out);
+    // То же для double: сумма с компенсацией и Σ (x - center)²
+    static double sum(const double* values, size_t n);
+    static double sumSquares(const double* values, size_t n, double center);
+
+    // Прогнать ядра всех доступных наборов команд на values случайных
+    // значениях (лучшее время из repeats повторов)
+    static std::vector<PHCKernelBenchmark> benchmark(size_t values, int repeats);
+};
+
+#endif // DIFFPHC_KERNELS_H
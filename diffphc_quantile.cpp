@@ -0,0 +1,233 @@
+#include "diffphc_quantile.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Поставить на места порядковые статистики ranks[0..count) (по возрастанию,
+// без повторов) в [first, last); ranks - индексы во всем массиве, first
+// соответствует индексу offset
+template <typename T>
+void multiSelect(T* first, T* last, const size_t* ranks, size_t count, size_t offset) {
+    if (count == 0 || first >= last) {
+        return;
+    }
+    const size_t mid = count / 2;
+    T* nth = first + (ranks[mid] - offset);
+    std::nth_element(first, nth, last);
+    multiSelect(first, nth, ranks, mid, offset);
+    multiSelect(nth + 1, last, ranks + mid + 1, count - mid - 1, ranks[mid] + 1);
+}
+
+// Позиция квантиля q в выборке из n значений
+inline double quantilePosition(double q, size_t n) {
+    return std::min(std::max(q * n - 0.5, 0.0), double(n - 1));
+}
+
+// Квантили по выборке, в которой порядковые статистики ranks уже на местах
+template <typename T>
+void interpolate(const T* values, size_t n, const double* q, size_t k, double* out) {
+    for (size_t i = 0; i < k; ++i) {
+        const double pos = quantilePosition(q[i], n);
+        const size_t lower = size_t(pos);
+        out[i] = lower + 1 < n ? values[lower] + (pos - lower) * double(values[lower + 1] - values[lower])
+                               : double(values[lower]);
+    }
+}
+
+template <typename T>
+void selectQuantiles(T* values, size_t n, const double* q, size_t k, double* out,
+                     std::vector<size_t>& ranks) {
+    if (n == 0) {
+        std::fill(out, out + k, 0.0);
+        return;
+    }
+    ranks.clear();
+    for (size_t i = 0; i < k; ++i) {
+        const size_t lower = size_t(quantilePosition(q[i], n));
+        ranks.push_back(lower);
+        if (lower + 1 < n) {
+            ranks.push_back(lower + 1);
+        }
+    }
+    std::sort(ranks.begin(), ranks.end());
+    ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+    multiSelect(values, values + n, ranks.data(), ranks.size(), 0);
+    interpolate(values, n, q, k, out);
+}
+
+} // namespace
+
+// PHCQuantileSketch implementation
+PHCQuantileSketch::PHCQuantileSketch(double compression)
+    : m_compression(std::max(10.0, compression)),
+      m_bufferLimit(size_t(5 * m_compression)) {
+    reserve();
+}
+
+PHCQuantileSketch::PHCQuantileSketch(const PHCQuantileSketch& other)
+    : m_compression(other.m_compression),
+      m_bufferLimit(other.m_bufferLimit),
+      m_count(other.m_count),
+      m_min(other.m_min),
+      m_max(other.m_max) {
+    reserve();
+    m_centroids = other.m_centroids;
+    m_buffer = other.m_buffer;
+}
+
+PHCQuantileSketch& PHCQuantileSketch::operator=(const PHCQuantileSketch& other) {
+    if (this != &other) {
+        m_compression = other.m_compression;
+        m_bufferLimit = other.m_bufferLimit;
+        m_count = other.m_count;
+        m_min = other.m_min;
+        m_max = other.m_max;
+        reserve();
+        m_centroids = other.m_centroids;
+        m_buffer = other.m_buffer;
+    }
+    return *this;
+}
+
+void PHCQuantileSketch::reserve() {
+    // Центроидов не больше 2·compression: каждая пара соседних занимает
+    // больше единицы шкалы k длиной compression/2
+    const size_t maxCentroids = size_t(2 * m_compression) + 1;
+    m_buffer.reserve(m_bufferLimit);
+    m_centroids.reserve(maxCentroids);
+    m_scratch.reserve(m_bufferLimit + maxCentroids);
+}
+
+void PHCQuantileSketch::reset() {
+    m_count = 0;
+    m_min = m_max = 0.0;
+    m_centroids.clear();
+    m_buffer.clear();
+}
+
+void PHCQuantileSketch::merge(const PHCQuantileSketch& other) {
+    if (other.m_count == 0) {
+        return;
+    }
+    if (m_count == 0 || other.m_min < m_min) {
+        m_min = other.m_min;
+    }
+    if (m_count == 0 || other.m_max > m_max) {
+        m_max = other.m_max;
+    }
+    m_count += other.m_count;
+    m_buffer.insert(m_buffer.end(), other.m_centroids.begin(), other.m_centroids.end());
+    m_buffer.insert(m_buffer.end(), other.m_buffer.begin(), other.m_buffer.end());
+    flush();
+}
+
+double PHCQuantileSketch::scale(double q) const {
+    return m_compression / (2 * M_PI) * std::asin(std::min(1.0, std::max(-1.0, 2 * q - 1)));
+}
+
+double PHCQuantileSketch::scaleInverse(double k) const {
+    double x = k * 2 * M_PI / m_compression;
+    if (x >= M_PI / 2) {
+        return 1.0;
+    }
+    return (std::sin(x) + 1) / 2;
+}
+
+void PHCQuantileSketch::flush() const {
+    if (m_buffer.empty()) {
+        return;
+    }
+    std::sort(m_buffer.begin(), m_buffer.end());
+    m_scratch.resize(m_buffer.size() + m_centroids.size());
+    std::merge(m_buffer.begin(), m_buffer.end(), m_centroids.begin(), m_centroids.end(),
+               m_scratch.begin());
+    m_buffer.clear();
+
+    // Жадное слияние соседей, пока вес центроида укладывается в единицу шкалы k
+    const double total = double(m_count);
+    m_centroids.clear();
+    double before = 0.0;        // Вес закрытых центроидов
+    double limit = total * scaleInverse(scale(0.0) + 1);
+    Centroid current = m_scratch.front();
+    for (size_t i = 1; i < m_scratch.size(); ++i) {
+        const Centroid& next = m_scratch[i];
+        const double weight = current.weight + next.weight;
+        if (before + weight <= limit) {
+            current.mean += (next.mean - current.mean) * next.weight / weight;
+            current.weight = weight;
+        } else {
+            m_centroids.push_back(current);
+            before += current.weight;
+            limit = total * scaleInverse(scale(before / total) + 1);
+            current = next;
+        }
+    }
+    m_centroids.push_back(current);
+}
+
+size_t PHCQuantileSketch::centroids() const {
+    flush();
+    return m_centroids.size();
+}
+
+double PHCQuantileSketch::quantile(double q) const {
+    if (m_count == 0) {
+        return 0.0;
+    }
+    flush();
+    q = std::min(1.0, std::max(0.0, q));
+    const double index = q * double(m_count);
+    const auto& c = m_centroids;
+
+    // Центроид представляет свои значения равномерно вокруг центра
+    // cumulative + weight/2; между центрами - линейная интерполяция,
+    // за крайними центрами - к точным минимуму и максимуму
+    if (index <= c.front().weight / 2) {
+        if (c.front().weight <= 1) {
+            return c.front().mean;
+        }
+        return m_min + (c.front().mean - m_min) * index / (c.front().weight / 2);
+    }
+    double center = c.front().weight / 2;
+    for (size_t i = 0; i + 1 < c.size(); ++i) {
+        const double step = (c[i].weight + c[i + 1].weight) / 2;
+        if (index < center + step) {
+            return c[i].mean + (c[i + 1].mean - c[i].mean) * (index - center) / step;
+        }
+        center += step;
+    }
+    if (c.back().weight <= 1) {
+        return c.back().mean;
+    }
+    const double half = c.back().weight / 2;
+    return c.back().mean + (m_max - c.back().mean) * std::min(1.0, (index - center) / half);
+}
+
+// PHCQuantileSelector implementation
+void PHCQuantileSelector::selectInPlace(int64_t* values, size_t n, const double* q, size_t k, double* out) {
+    selectQuantiles(values, n, q, k, out, m_ranks);
+}
+
+void PHCQuantileSelector::select(const int64_t* values, size_t n, const double* q, size_t k, double* out) {
+    m_values.assign(values, values + n);
+    selectQuantiles(m_values.data(), n, q, k, out, m_ranks);
+}
+
+double PHCQuantileSelector::median(const std::vector<int64_t>& values) {
+    const double q = 0.5;
+    double out = 0.0;
+    select(values.data(), values.size(), &q, 1, &out);
+    return out;
+}
+
+double PHCQuantileSelector::medianAbsoluteDeviation(const std::vector<int64_t>& values, double center) {
+    m_deviations.resize(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        m_deviations[i] = std::abs(values[i] - center);
+    }
+    const double q = 0.5;
+    double out = 0.0;
+    selectQuantiles(m_deviations.data(), m_deviations.size(), &q, 1, &out, m_ranks);
+    return out;
+}
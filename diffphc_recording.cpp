@@ -0,0 +1,858 @@
+#include "diffphc_recording.h"
+#include "diffphc_clock_source.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+size_t frameSizeFor(size_t numDevices) {
+    return sizeof(PHCRecordingFrame) +
+           numDevices * (sizeof(int64_t) + sizeof(PHCRecordingReading));
+}
+
+} // namespace
+
+// PHCRecordingWriter implementation
+PHCRecordingWriter::~PHCRecordingWriter() {
+    close();
+}
+
+bool PHCRecordingWriter::open(const std::string& path, const PHCConfig& config, std::string& error) {
+    close();
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file) {
+        error = "Failed to create recording '" + path + "': " + strerror(errno);
+        return false;
+    }
+    // Крупный буфер: запись на диск не чаще раза в несколько сотен кадров
+    setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+    m_config = config;
+    m_error.clear();
+    m_frames = 0;
+    m_index.clear();
+    return true;
+}
+
+bool PHCRecordingWriter::write(const void* data, size_t size) {
+    if (fwrite(data, 1, size, m_file) != size) {
+        if (m_error.empty()) {
+            m_error = std::string("Recording write failed: ") + strerror(errno);
+        }
+        return false;
+    }
+    return true;
+}
+
+void PHCRecordingWriter::onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) {
+    if (!m_file) {
+        return;
+    }
+    m_numDevices = devices.size();
+    m_frame.assign(frameSizeFor(m_numDevices), 0);
+
+    PHCRecordingHeader header = {};
+    memcpy(header.magic, PHC_RECORDING_MAGIC, sizeof(header.magic));
+    header.version = PHC_RECORDING_VERSION;
+    header.headerSize = sizeof(PHCRecordingHeader) + m_numDevices * sizeof(PHCRecordingDevice);
+    header.numDevices = m_numDevices;
+    header.frameSize = m_frame.size();
+    header.count = m_config.count;
+    header.delay = m_config.delay;
+    header.samples = m_config.samples;
+    header.flags = (m_config.parallel ? PHC_RECORDING_PARALLEL : 0) |
+                   (m_config.realtime ? PHC_RECORDING_REALTIME : 0) |
+                   (m_config.adaptiveSamples ? PHC_RECORDING_ADAPTIVE : 0) |
+                   (m_config.simulate ? PHC_RECORDING_SIMULATED : 0);
+    header.startTime = DiffPHCCore::getCPUNow();
+    header.indexInterval = DEFAULT_INDEX_INTERVAL;
+    write(&header, sizeof(header));
+
+    for (size_t d = 0; d < m_numDevices; ++d) {
+        PHCRecordingDevice device = {};
+        device.device = devices[d];
+        device.method = d < methods.size() ? int32_t(methods[d]) : int32_t(PHCReadMethod::None);
+        std::string source = PHCClockSource::sourceName(devices[d], m_config);
+        strncpy(device.source, source.c_str(), sizeof(device.source) - 1);
+        write(&device, sizeof(device));
+    }
+}
+
+bool PHCRecordingWriter::onSample(const PHCSampleView& sample) {
+    if (!m_file || sample.numDevices != m_numDevices) {
+        return true;
+    }
+
+    // Кадр собирается в буфере и пишется одним вызовом
+    uint8_t* p = m_frame.data();
+    PHCRecordingFrame frame = {};
+    frame.sequence = sample.sequence;
+    frame.timestamp = sample.timestamp;
+    frame.lateness = sample.lateness;
+    frame.valid = sample.valid ? 1 : 0;
+    memcpy(p, &frame, sizeof(frame));
+    p += sizeof(frame);
+    memcpy(p, sample.offsets, m_numDevices * sizeof(int64_t));
+    p += m_numDevices * sizeof(int64_t);
+    for (size_t d = 0; d < m_numDevices; ++d) {
+        const PHCReading& r = sample.readings[d];
+        PHCRecordingReading reading = {};
+        reading.minDelay = r.minDelay;
+        reading.meanDelay = r.meanDelay;
+        reading.callNs = r.callNs;
+        reading.samples = r.samples;
+        reading.accepted = r.accepted;
+        reading.error = r.error;
+        memcpy(p, &reading, sizeof(reading));
+        p += sizeof(reading);
+    }
+
+    if (m_frames % DEFAULT_INDEX_INTERVAL == 0) {
+        m_index.push_back({sample.timestamp, m_frames});
+    }
+    // Ошибка записи не прерывает измерение; она доступна через error()
+    if (write(m_frame.data(), m_frame.size())) {
+        m_frames++;
+    }
+    return true;
+}
+
+bool PHCRecordingWriter::close() {
+    if (!m_file) {
+        return m_error.empty();
+    }
+
+    if (!m_frame.empty()) {
+        PHCRecordingTrailer trailer = {};
+        memcpy(trailer.magic, PHC_RECORDING_INDEX_MAGIC, sizeof(trailer.magic));
+        trailer.indexOffset = sizeof(PHCRecordingHeader) +
+                              m_numDevices * sizeof(PHCRecordingDevice) + m_frames * m_frame.size();
+        trailer.entries = m_index.size();
+        trailer.frames = m_frames;
+        write(m_index.data(), m_index.size() * sizeof(PHCRecordingIndexEntry));
+        write(&trailer, sizeof(trailer));
+    }
+
+    if (fclose(m_file) != 0 && m_error.empty()) {
+        m_error = std::string("Recording close failed: ") + strerror(errno);
+    }
+    m_file = nullptr;
+    m_frame.clear();
+    return m_error.empty();
+}
+
+bool PHCRecordingWriter::writeResult(const std::string& path, const PHCConfig& config,
+                                     const PHCResult& result, std::string& error) {
+    PHCRecordingWriter writer;
+    if (!writer.open(path, config, error)) {
+        return false;
+    }
+
+    const auto& series = result.series;
+    writer.onStart(result.devices, result.methods);
+    std::vector<int64_t> offsets(series.numDevices());
+    std::vector<PHCReading> readings(series.numDevices());
+    for (size_t row = 0; row < series.size(); ++row) {
+        for (size_t d = 0; d < series.numDevices(); ++d) {
+            offsets[d] = series.offset(row, d);
+            readings[d] = series.reading(row, d);
+        }
+        PHCSampleView view = {};
+        view.sequence = series.sequence(row);
+        view.timestamp = series.timestamp(row);
+        view.lateness = series.lateness(row);
+        view.numDevices = series.numDevices();
+        view.offsets = offsets.data();
+        view.readings = readings.data();
+        view.valid = series.valid(row);
+        writer.onSample(view);
+    }
+
+    if (!writer.close()) {
+        error = writer.error();
+        return false;
+    }
+    return true;
+}
+
+// PHCRecordingReader implementation
+PHCRecordingReader::~PHCRecordingReader() {
+    close();
+}
+
+void PHCRecordingReader::close() {
+    if (m_data) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+    m_deviceTable = nullptr;
+    m_index = nullptr;
+    m_indexEntries = 0;
+    m_frames = 0;
+    m_devices.clear();
+    m_methods.clear();
+}
+
+bool PHCRecordingReader::open(const std::string& path, std::string& error) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Failed to open recording '" + path + "': " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(PHCRecordingHeader)) {
+        ::close(fd);
+        error = "Recording '" + path + "' is too short";
+        return false;
+    }
+    m_size = st.st_size;
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        m_size = 0;
+        error = "Failed to map recording '" + path + "': " + strerror(errno);
+        return false;
+    }
+    m_data = static_cast<const uint8_t*>(data);
+    m_header = reinterpret_cast<const PHCRecordingHeader*>(m_data);
+
+    const auto& h = *m_header;
+    if (memcmp(h.magic, PHC_RECORDING_MAGIC, sizeof(h.magic)) != 0 ||
+        h.version != PHC_RECORDING_VERSION) {
+        close();
+        error = "'" + path + "' is not a PHC recording";
+        return false;
+    }
+    if (h.numDevices == 0 || h.headerSize != sizeof(PHCRecordingHeader) + h.numDevices * sizeof(PHCRecordingDevice) ||
+        h.frameSize != frameSizeFor(h.numDevices) || h.headerSize > m_size) {
+        close();
+        error = "Recording '" + path + "' has a corrupted header";
+        return false;
+    }
+
+    m_deviceTable = reinterpret_cast<const PHCRecordingDevice*>(m_data + sizeof(PHCRecordingHeader));
+    for (size_t d = 0; d < h.numDevices; ++d) {
+        m_devices.push_back(m_deviceTable[d].device);
+        m_methods.push_back(PHCReadMethod(m_deviceTable[d].method));
+    }
+    m_readings.assign(h.numDevices, PHCReading());
+
+    // Штатно закрытая запись заканчивается индексом и трейлером
+    size_t body = m_size - h.headerSize;
+    if (m_size >= h.headerSize + sizeof(PHCRecordingTrailer)) {
+        const auto* trailer = reinterpret_cast<const PHCRecordingTrailer*>(
+            m_data + m_size - sizeof(PHCRecordingTrailer));
+        if (memcmp(trailer->magic, PHC_RECORDING_INDEX_MAGIC, sizeof(trailer->magic)) == 0 &&
+            trailer->indexOffset == h.headerSize + trailer->frames * h.frameSize &&
+            trailer->indexOffset + trailer->entries * sizeof(PHCRecordingIndexEntry) +
+                sizeof(PHCRecordingTrailer) == m_size) {
+            m_index = reinterpret_cast<const PHCRecordingIndexEntry*>(m_data + trailer->indexOffset);
+            m_indexEntries = trailer->entries;
+            m_frames = trailer->frames;
+            return true;
+        }
+    }
+    // Оборванная запись: только целые кадры
+    m_frames = body / h.frameSize;
+    return true;
+}
+
+std::string PHCRecordingReader::sourceName(size_t device) const {
+    const auto& source = m_deviceTable[device].source;
+    return std::string(source, strnlen(source, sizeof(source)));
+}
+
+PHCConfig PHCRecordingReader::config() const {
+    PHCConfig config;
+    config.count = m_header->count;
+    config.delay = m_header->delay;
+    config.samples = m_header->samples;
+    config.parallel = m_header->flags & PHC_RECORDING_PARALLEL;
+    config.realtime = m_header->flags & PHC_RECORDING_REALTIME;
+    config.adaptiveSamples = m_header->flags & PHC_RECORDING_ADAPTIVE;
+    config.simulate = m_header->flags & PHC_RECORDING_SIMULATED;
+    config.devices = m_devices;
+    return config;
+}
+
+PHCSampleView PHCRecordingReader::frame(size_t index) const {
+    const size_t n = m_header->numDevices;
+    const auto* frame = frameAt(index);
+    const auto* offsets = reinterpret_cast<const int64_t*>(frame + 1);
+    const auto* readings = reinterpret_cast<const PHCRecordingReading*>(offsets + n);
+    for (size_t d = 0; d < n; ++d) {
+        auto& r = m_readings[d];
+        r.offset = offsets[d];
+        r.minDelay = readings[d].minDelay;
+        r.meanDelay = readings[d].meanDelay;
+        r.callNs = readings[d].callNs;
+        r.samples = readings[d].samples;
+        r.accepted = readings[d].accepted;
+        r.error = readings[d].error;
+    }
+
+    PHCSampleView view = {};
+    view.sequence = frame->sequence;
+    view.timestamp = frame->timestamp;
+    view.lateness = frame->lateness;
+    view.numDevices = n;
+    view.offsets = offsets;
+    view.readings = m_readings.data();
+    view.valid = frame->valid != 0;
+    return view;
+}
+
+size_t PHCRecordingReader::findFrame(int64_t timestamp) const {
+    // Индекс сужает поиск до одного интервала, внутри - двоичный поиск по кадрам
+    size_t lo = 0;
+    size_t hi = m_frames;
+    if (m_index && m_indexEntries > 0) {
+        auto it = std::upper_bound(m_index, m_index + m_indexEntries, timestamp,
+                                   [](int64_t t, const PHCRecordingIndexEntry& entry) {
+                                       return t <= entry.timestamp;
+                                   });
+        if (it != m_index) {
+            lo = (it - 1)->frame;
+        }
+        if (it != m_index + m_indexEntries) {
+            hi = std::min<size_t>(hi, it->frame);
+        }
+    }
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (frameAt(mid)->timestamp < timestamp) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool PHCRecordingReader::replay(MeasurementSink& sink, int64_t from, int64_t to) const {
+    sink.onStart(m_devices, m_methods);
+    bool completed = true;
+    for (size_t i = from == INT64_MIN ? 0 : findFrame(from); i < m_frames; ++i) {
+        if (frameAt(i)->timestamp > to) {
+            break;
+        }
+        if (!sink.onSample(frame(i))) {
+            completed = false;
+            break;
+        }
+    }
+    sink.onStop();
+    return completed;
+}
+
+// PHCReplay implementation
+namespace {
+
+// Разбор JSON, который выводит shiwadiffphc-cli: поиск ключа и массивов
+// чисел без построения дерева документа
+bool findJSONKey(const std::string& text, const char* key, size_t& pos, size_t from = 0) {
+    const std::string pattern = std::string("\"") + key + "\"";
+    size_t at = text.find(pattern, from);
+    if (at == std::string::npos) {
+        return false;
+    }
+    at = text.find(':', at + pattern.size());
+    if (at == std::string::npos) {
+        return false;
+    }
+    pos = at + 1;
+    return true;
+}
+
+void skipSpace(const std::string& text, size_t& pos) {
+    while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) {
+        pos++;
+    }
+}
+
+// Число, true (1) или false (0)
+bool parseJSONValue(const std::string& text, size_t& pos, int64_t& value) {
+    skipSpace(text, pos);
+    if (text.compare(pos, 4, "true") == 0) {
+        value = 1;
+        pos += 4;
+        return true;
+    }
+    if (text.compare(pos, 5, "false") == 0) {
+        value = 0;
+        pos += 5;
+        return true;
+    }
+    const char* begin = text.c_str() + pos;
+    char* end = nullptr;
+    value = strtoll(begin, &end, 10);
+    if (end == begin) {
+        return false;
+    }
+    // Дробная часть (средние значения) отбрасывается
+    if (*end == '.') {
+        value = int64_t(strtod(begin, &end));
+    }
+    pos += end - begin;
+    return true;
+}
+
+bool parseJSONArray(const std::string& text, size_t& pos, std::vector<int64_t>& out) {
+    out.clear();
+    skipSpace(text, pos);
+    if (pos >= text.size() || text[pos] != '[') {
+        return false;
+    }
+    pos++;
+    skipSpace(text, pos);
+    if (pos < text.size() && text[pos] == ']') {
+        pos++;
+        return true;
+    }
+    while (pos < text.size()) {
+        int64_t value;
+        if (!parseJSONValue(text, pos, value)) {
+            return false;
+        }
+        out.push_back(value);
+        skipSpace(text, pos);
+        if (pos < text.size() && text[pos] == ',') {
+            pos++;
+        } else if (pos < text.size() && text[pos] == ']') {
+            pos++;
+            return true;
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool parseJSONKeyArray(const std::string& text, const char* key, std::vector<int64_t>& out) {
+    size_t pos;
+    return findJSONKey(text, key, pos) && parseJSONArray(text, pos, out);
+}
+
+bool parseJSONKeyValue(const std::string& text, const char* key, int64_t& value, size_t from = 0) {
+    size_t pos;
+    return findJSONKey(text, key, pos, from) && parseJSONValue(text, pos, value);
+}
+
+// Строки в кавычках внутри массива: ["precise", "extended"]
+std::vector<std::string> parseJSONStrings(const std::string& text, const char* key) {
+    std::vector<std::string> values;
+    size_t pos;
+    if (!findJSONKey(text, key, pos)) {
+        return values;
+    }
+    size_t end = text.find(']', pos);
+    while (pos < end) {
+        size_t open = text.find('"', pos);
+        if (open == std::string::npos || open > end) {
+            break;
+        }
+        size_t close = text.find('"', open + 1);
+        if (close == std::string::npos || close > end) {
+            break;
+        }
+        values.push_back(text.substr(open + 1, close - open - 1));
+        pos = close + 1;
+    }
+    return values;
+}
+
+// Поля CSV через запятую; false - поле не является целым числом
+bool parseCSVFields(const std::string& line, std::vector<int64_t>& out) {
+    out.clear();
+    const char* p = line.c_str();
+    while (*p) {
+        char* end = nullptr;
+        int64_t value = strtoll(p, &end, 10);
+        if (end == p || (*end != ',' && *end != '\0' && *end != '\r')) {
+            return false;
+        }
+        out.push_back(value);
+        p = *end == ',' ? end + 1 : end + strlen(end);
+    }
+    return true;
+}
+
+// Строк данных для оценки интервала измерения
+constexpr size_t DelayEstimateRows = 17;
+
+// Интервал измерения по медиане шагов первых меток времени (мкс): первая
+// итерация часто опаздывает, а пропущенные дедлайны удлиняют шаг
+int estimateDelay(const std::vector<int64_t>& timestamps, int fallback) {
+    if (timestamps.size() < 2) {
+        return fallback;
+    }
+    std::vector<int64_t> steps(timestamps.size() - 1);
+    for (size_t k = 1; k < timestamps.size(); ++k) {
+        steps[k - 1] = timestamps[k] - timestamps[k - 1];
+    }
+    std::nth_element(steps.begin(), steps.begin() + steps.size() / 2, steps.end());
+    int64_t delay = (steps[steps.size() / 2] + 500) / 1000;
+    return delay >= 1 && delay <= 10000000 ? int(delay) : fallback;
+}
+
+} // namespace
+
+const char* PHCReplay::formatName(Format format) {
+    switch (format) {
+        case Format::Recording: return "phcrec";
+        case Format::CSV: return "csv";
+        case Format::JSON: return "json";
+        case Format::JSONLines: return "jsonl";
+    }
+    return "unknown";
+}
+
+bool PHCReplay::open(const std::string& path, std::string& error) {
+    m_path = path;
+    m_config = PHCConfig();
+    m_methods.clear();
+
+    char magic[sizeof(PHC_RECORDING_MAGIC)] = {};
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "Failed to open '" + path + "': " + strerror(errno);
+        return false;
+    }
+    size_t got = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+
+    if (got == sizeof(magic) && memcmp(magic, PHC_RECORDING_MAGIC, sizeof(magic)) == 0) {
+        m_format = Format::Recording;
+        if (!m_recording.open(path, error)) {
+            return false;
+        }
+        m_config = m_recording.config();
+        m_methods = m_recording.methods();
+        return true;
+    }
+    return openText(error);
+}
+
+bool PHCReplay::openText(std::string& error) {
+    std::ifstream in(m_path);
+    std::string line;
+    std::vector<int64_t> fields;
+    int64_t value;
+
+    while (std::getline(in, line)) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos) {
+            continue;
+        }
+
+        if (line[start] == '{') {
+            // Строка с полем iteration - JSON Lines, иначе итоговый документ
+            if (line.find("\"iteration\"") != std::string::npos) {
+                m_format = Format::JSONLines;
+                std::vector<int64_t> offsets;
+                if (!parseJSONKeyArray(line, "offsets", offsets) || offsets.empty()) {
+                    error = "'" + m_path + "': JSON line without offsets";
+                    return false;
+                }
+                for (size_t d = 0; d < offsets.size(); ++d) {
+                    m_config.devices.push_back(d);
+                }
+                std::vector<int64_t> timestamps;
+                do {
+                    if (!parseJSONKeyValue(line, "timestamp", value)) {
+                        break;
+                    }
+                    timestamps.push_back(value);
+                } while (timestamps.size() < DelayEstimateRows && std::getline(in, line));
+                m_config.delay = estimateDelay(timestamps, m_config.delay);
+                m_methods.assign(offsets.size(), PHCReadMethod::None);
+                return true;
+            }
+
+            m_format = Format::JSON;
+            std::stringstream document;
+            document << line << "\n" << in.rdbuf();
+            const std::string text = document.str();
+            std::vector<int64_t> devices;
+            if (!parseJSONKeyArray(text, "devices", devices) || devices.empty()) {
+                error = "'" + m_path + "': JSON without devices";
+                return false;
+            }
+            m_config.devices.assign(devices.begin(), devices.end());
+            for (const auto& name : parseJSONStrings(text, "read_methods")) {
+                PHCReadMethod method = PHCReadMethod::None;
+                DiffPHCCore::parseReadMethod(name, method);
+                m_methods.push_back(method);
+            }
+            m_methods.resize(devices.size(), PHCReadMethod::None);
+            if (parseJSONKeyValue(text, "period_ns", value) && value >= 1000) {
+                m_config.delay = value / 1000;
+            }
+            return true;
+        }
+
+        if (line[start] == '#') {
+            // "# Способ чтения: ptp0=extended ptp1=precise"
+            std::stringstream ss(line.substr(line.find(':') + 1));
+            std::string item;
+            m_methods.clear();
+            while (ss >> item) {
+                PHCReadMethod method = PHCReadMethod::None;
+                auto eq = item.find('=');
+                if (eq != std::string::npos) {
+                    DiffPHCCore::parseReadMethod(item.substr(eq + 1), method);
+                }
+                m_methods.push_back(method);
+            }
+            continue;
+        }
+
+        if (line.compare(start, 10, "iteration,") == 0) {
+            m_format = Format::CSV;
+            std::stringstream ss(line);
+            std::string column;
+            while (std::getline(ss, column, ',')) {
+                if (column.compare(0, 3, "ptp") == 0 && column.find('_') == std::string::npos) {
+                    m_config.devices.push_back(std::stoi(column.substr(3)));
+                }
+            }
+            if (m_config.devices.empty()) {
+                error = "'" + m_path + "': CSV without device columns";
+                return false;
+            }
+            m_methods.resize(m_config.devices.size(), PHCReadMethod::None);
+            // Интервал по первым строкам данных
+            std::vector<int64_t> timestamps;
+            while (timestamps.size() < DelayEstimateRows && std::getline(in, line) &&
+                   parseCSVFields(line, fields) && fields.size() > 1) {
+                timestamps.push_back(fields[1]);
+            }
+            m_config.delay = estimateDelay(timestamps, m_config.delay);
+            return true;
+        }
+
+        break;
+    }
+
+    error = "'" + m_path + "' is not a PHC recording or shiwadiffphc-cli CSV/JSON output";
+    return false;
+}
+
+bool PHCReplay::run(MeasurementSink& sink, std::string& error) {
+    switch (m_format) {
+        case Format::Recording:
+            m_recording.replay(sink);
+            return true;
+        case Format::CSV:
+            return runCSV(sink, error);
+        case Format::JSON:
+            return runJSON(sink, error);
+        case Format::JSONLines:
+            return runJSONLines(sink, error);
+    }
+    return false;
+}
+
+bool PHCReplay::runCSV(MeasurementSink& sink, std::string& error) {
+    std::ifstream in(m_path);
+    std::vector<char> buffer(1 << 20);
+    in.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+
+    const size_t n = m_config.devices.size();
+    std::vector<int64_t> fields;
+    std::vector<PHCReading> readings(n);
+    std::string line;
+    size_t lineNumber = 0;
+    bool data = false;
+
+    sink.onStart(m_config.devices, m_methods);
+    while (std::getline(in, line)) {
+        lineNumber++;
+        if (!data) {
+            data = line.compare(0, 10, "iteration,") == 0;
+            continue;
+        }
+        // Данные заканчиваются пустой строкой или блоком статистики
+        if (line.empty() || line[0] == '#' || line[0] == '\r') {
+            break;
+        }
+        if (!parseCSVFields(line, fields) || fields.size() < 3 + n) {
+            error = "'" + m_path + "' line " + std::to_string(lineNumber) + ": malformed CSV row";
+            sink.onStop();
+            return false;
+        }
+
+        // Колонки чтений (errno, принято, задержка, длительность) необязательны
+        const bool hasReadings = fields.size() >= 3 + 5 * n;
+        bool valid = true;
+        for (size_t d = 0; d < n; ++d) {
+            auto& r = readings[d];
+            r = PHCReading();
+            r.offset = fields[3 + d];
+            if (hasReadings) {
+                const int64_t* f = &fields[3 + n + 4 * d];
+                r.error = int(f[0]);
+                r.accepted = int(f[1]);
+                r.samples = r.accepted;
+                r.meanDelay = f[2];
+                r.minDelay = f[2];
+                r.callNs = f[3];
+            }
+            valid = valid && r.ok();
+        }
+
+        PHCSampleView view = {};
+        view.sequence = fields[0];
+        view.timestamp = fields[1];
+        view.lateness = fields[2];
+        view.numDevices = n;
+        view.offsets = &fields[3];
+        view.readings = readings.data();
+        view.valid = valid;
+        if (!sink.onSample(view)) {
+            break;
+        }
+    }
+    sink.onStop();
+    return true;
+}
+
+bool PHCReplay::runJSON(MeasurementSink& sink, std::string& error) {
+    std::ifstream in(m_path);
+    std::stringstream document;
+    document << in.rdbuf();
+    const std::string text = document.str();
+
+    const size_t n = m_config.devices.size();
+    std::vector<int64_t> timestamps;
+    std::vector<int64_t> lateness;
+    std::vector<int64_t> valid;
+    size_t pos;
+    if (!parseJSONKeyArray(text, "timestamps", timestamps) || !findJSONKey(text, "measurements", pos)) {
+        error = "'" + m_path + "': JSON without measurements (written with --stats-only?)";
+        return false;
+    }
+    parseJSONKeyArray(text, "lateness", lateness);
+    parseJSONKeyArray(text, "valid", valid);
+
+    skipSpace(text, pos);
+    if (pos >= text.size() || text[pos] != '[') {
+        error = "'" + m_path + "': malformed measurements";
+        return false;
+    }
+    pos++;
+
+    std::vector<int64_t> offsets;
+    std::vector<PHCReading> readings(n);
+    sink.onStart(m_config.devices, m_methods);
+    for (size_t m = 0; m < timestamps.size(); ++m) {
+        if (!parseJSONArray(text, pos, offsets) || offsets.size() != n) {
+            error = "'" + m_path + "': malformed measurement " + std::to_string(m);
+            sink.onStop();
+            return false;
+        }
+        skipSpace(text, pos);
+        if (pos < text.size() && text[pos] == ',') {
+            pos++;
+        }
+
+        // Устройство с ошибкой в документе не сохраняется: ошибка у всех
+        const bool ok = m >= valid.size() || valid[m] != 0;
+        for (size_t d = 0; d < n; ++d) {
+            readings[d] = PHCReading();
+            readings[d].offset = offsets[d];
+            readings[d].error = ok ? 0 : EIO;
+        }
+
+        PHCSampleView view = {};
+        view.sequence = m;
+        view.timestamp = timestamps[m];
+        view.lateness = m < lateness.size() ? lateness[m] : 0;
+        view.numDevices = n;
+        view.offsets = offsets.data();
+        view.readings = readings.data();
+        view.valid = ok;
+        if (!sink.onSample(view)) {
+            break;
+        }
+    }
+    sink.onStop();
+    return true;
+}
+
+bool PHCReplay::runJSONLines(MeasurementSink& sink, std::string& error) {
+    std::ifstream in(m_path);
+    const size_t n = m_config.devices.size();
+    std::vector<int64_t> offsets;
+    std::vector<PHCReading> readings(n);
+    std::string line;
+    size_t lineNumber = 0;
+
+    sink.onStart(m_config.devices, m_methods);
+    while (std::getline(in, line)) {
+        lineNumber++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        int64_t sequence = 0;
+        int64_t timestamp = 0;
+        int64_t lateness = 0;
+        if (!parseJSONKeyValue(line, "iteration", sequence) ||
+            !parseJSONKeyValue(line, "timestamp", timestamp) ||
+            !parseJSONKeyArray(line, "offsets", offsets) || offsets.size() != n) {
+            error = "'" + m_path + "' line " + std::to_string(lineNumber) + ": malformed JSON line";
+            sink.onStop();
+            return false;
+        }
+        parseJSONKeyValue(line, "lateness", lateness);
+
+        // Объекты readings идут по порядку устройств
+        size_t from = 0;
+        findJSONKey(line, "readings", from);
+        bool valid = true;
+        for (size_t d = 0; d < n; ++d) {
+            auto& r = readings[d];
+            r = PHCReading();
+            r.offset = offsets[d];
+            int64_t value;
+            size_t at;
+            if (from && findJSONKey(line, "error", at, from)) {
+                parseJSONValue(line, at, value);
+                r.error = int(value);
+                if (parseJSONKeyValue(line, "accepted", value, at)) {
+                    r.accepted = r.samples = int(value);
+                }
+                if (parseJSONKeyValue(line, "delay", value, at)) {
+                    r.meanDelay = r.minDelay = value;
+                }
+                if (parseJSONKeyValue(line, "call_ns", value, at)) {
+                    r.callNs = value;
+                }
+                from = line.find('}', at);
+                from = from == std::string::npos ? 0 : from;
+            }
+            valid = valid && r.ok();
+        }
+
+        PHCSampleView view = {};
+        view.sequence = sequence;
+        view.timestamp = timestamp;
+        view.lateness = lateness;
+        view.numDevices = n;
+        view.offsets = offsets.data();
+        view.readings = readings.data();
+        view.valid = valid;
+        if (!sink.onSample(view)) {
+            break;
+        }
+    }
+    sink.onStop();
+    return true;
+}
@@ -0,0 +1,205 @@
+#ifndef DIFFPHC_RECORDING_H
+#define DIFFPHC_RECORDING_H
+
+#include "diffphc_core.h"
+#include <cstdio>
+
+// Двоичная запись сеанса измерений (.phcrec). Файл дописывается только
+// в конец и читается через mmap без разбора:
+//
+//   PHCRecordingHeader
+//   PHCRecordingDevice[numDevices]
+//   кадр[frames]: PHCRecordingFrame, int64_t offsets[numDevices],
+//                 PHCRecordingReading readings[numDevices]
+//   индекс: PHCRecordingIndexEntry[entries] - каждый indexInterval-й кадр
+//   PHCRecordingTrailer
+//
+// Кадры фиксированного размера, поэтому кадр n лежит по адресу
+// headerSize + n * frameSize. Индекс и трейлер пишутся при закрытии;
+// у записи, оборванной аварийно, их нет, и поиск по времени идет
+// двоичным поиском по самим кадрам. Все поля - в порядке байт хоста.
+
+constexpr char PHC_RECORDING_MAGIC[8] = {'P', 'H', 'C', 'R', 'E', 'C', '1', '\0'};
+constexpr char PHC_RECORDING_INDEX_MAGIC[8] = {'P', 'H', 'C', 'I', 'D', 'X', '1', '\0'};
+constexpr uint32_t PHC_RECORDING_VERSION = 1;
+
+// Флаги конфигурации в заголовке
+constexpr uint32_t PHC_RECORDING_PARALLEL = 1u << 0;
+constexpr uint32_t PHC_RECORDING_REALTIME = 1u << 1;
+constexpr uint32_t PHC_RECORDING_ADAPTIVE = 1u << 2;
+constexpr uint32_t PHC_RECORDING_SIMULATED = 1u << 3;
+
+struct PHCRecordingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;        // Заголовок с таблицей устройств, кратен 8
+    uint32_t numDevices;
+    uint32_t frameSize;         // Байт на кадр, кратен 8
+    int32_t count;              // Конфигурация измерения
+    int32_t delay;
+    int32_t samples;
+    uint32_t flags;             // PHC_RECORDING_*
+    int64_t startTime;          // Время создания записи (CLOCK_REALTIME, нс)
+    uint32_t indexInterval;     // Кадров между записями индекса
+    uint32_t reserved;
+};
+
+struct PHCRecordingDevice {
+    int32_t device;             // Номер /dev/ptpN
+    int32_t method;             // PHCReadMethod
+    char source[56];            // Источник времени: /dev/ptpN или sim:ptpN
+};
+
+struct PHCRecordingFrame {
+    uint64_t sequence;
+    int64_t timestamp;
+    int64_t lateness;
+    uint32_t valid;
+    uint32_t reserved;
+};
+
+struct PHCRecordingReading {
+    int64_t minDelay;
+    int64_t meanDelay;
+    int64_t callNs;
+    int32_t samples;
+    int32_t accepted;
+    int32_t error;
+    int32_t reserved;
+};
+
+struct PHCRecordingIndexEntry {
+    int64_t timestamp;
+    uint64_t frame;
+};
+
+struct PHCRecordingTrailer {
+    char magic[8];
+    uint64_t indexOffset;       // Смещение индекса от начала файла
+    uint64_t entries;
+    uint64_t frames;
+};
+
+// Запись сеанса: приемник потока измерений, дописывающий кадры в файл.
+// Заголовок пишется в onStart(), индекс - в close() (или onStop()).
+class PHCRecordingWriter : public MeasurementSink {
+public:
+    static constexpr uint32_t DEFAULT_INDEX_INTERVAL = 1024;
+
+    PHCRecordingWriter() = default;
+    ~PHCRecordingWriter() override;
+    PHCRecordingWriter(const PHCRecordingWriter&) = delete;
+    PHCRecordingWriter& operator=(const PHCRecordingWriter&) = delete;
+
+    // Создать файл для измерения с конфигурацией config
+    bool open(const std::string& path, const PHCConfig& config, std::string& error);
+    // Дописать индекс и закрыть файл
+    bool close();
+    bool isOpen() const { return m_file != nullptr; }
+    // Первая ошибка записи (пусто - без ошибок)
+    const std::string& error() const { return m_error; }
+    uint64_t frames() const { return m_frames; }
+
+    void onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) override;
+    bool onSample(const PHCSampleView& sample) override;
+    void onStop() override { close(); }
+
+    // Записать сохраненный результат целиком: заголовок и все итерации
+    static bool writeResult(const std::string& path, const PHCConfig& config,
+                            const PHCResult& result, std::string& error);
+
+private:
+    bool write(const void* data, size_t size);
+
+    FILE* m_file = nullptr;
+    PHCConfig m_config;
+    std::string m_error;
+    size_t m_numDevices = 0;
+    uint64_t m_frames = 0;
+    std::vector<uint8_t> m_frame;                   // Буфер одного кадра
+    std::vector<PHCRecordingIndexEntry> m_index;
+};
+
+// Чтение записи через mmap: открытие не зависит от размера файла,
+// кадры читаются прямо из отображенной памяти
+class PHCRecordingReader {
+public:
+    PHCRecordingReader() = default;
+    ~PHCRecordingReader();
+    PHCRecordingReader(const PHCRecordingReader&) = delete;
+    PHCRecordingReader& operator=(const PHCRecordingReader&) = delete;
+
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    const PHCRecordingHeader& header() const { return *m_header; }
+    size_t numDevices() const { return m_header->numDevices; }
+    const std::vector<int>& devices() const { return m_devices; }
+    const std::vector<PHCReadMethod>& methods() const { return m_methods; }
+    std::string sourceName(size_t device) const;
+    // Конфигурация измерения из заголовка (устройства, интервал, отсчеты, флаги)
+    PHCConfig config() const;
+    size_t frameCount() const { return m_frames; }
+    // Запись закрыта штатно и содержит индекс
+    bool indexed() const { return m_index != nullptr; }
+
+    // Представление кадра; указатели действительны до следующего вызова
+    PHCSampleView frame(size_t index) const;
+    int64_t timestamp(size_t index) const { return frameAt(index)->timestamp; }
+    // Первый кадр с меткой времени не раньше timestamp
+    size_t findFrame(int64_t timestamp) const;
+    // Передать приемнику кадры с метками времени в [from, to]; false - приемник остановил
+    bool replay(MeasurementSink& sink, int64_t from = INT64_MIN, int64_t to = INT64_MAX) const;
+
+private:
+    const PHCRecordingFrame* frameAt(size_t index) const {
+        return reinterpret_cast<const PHCRecordingFrame*>(m_data + m_header->headerSize +
+                                                          index * m_header->frameSize);
+    }
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    const PHCRecordingHeader* m_header = nullptr;
+    const PHCRecordingDevice* m_deviceTable = nullptr;
+    const PHCRecordingIndexEntry* m_index = nullptr;
+    size_t m_indexEntries = 0;
+    size_t m_frames = 0;
+    std::vector<int> m_devices;
+    std::vector<PHCReadMethod> m_methods;
+    mutable std::vector<PHCReading> m_readings;     // Чтения текущего кадра
+};
+
+// Воспроизведение сохраненного сеанса через приемник потока измерений.
+// Формат определяется по содержимому файла: запись .phcrec, CSV или JSON
+// вывода shiwadiffphc-cli (итоговый документ или JSON Lines непрерывного
+// режима). Текстовые форматы хранят не все поля: отсутствующие метаданные
+// чтения остаются нулевыми, а номера устройств JSON Lines - 0..N-1.
+class PHCReplay {
+public:
+    enum class Format { Recording, CSV, JSON, JSONLines };
+
+    bool open(const std::string& path, std::string& error);
+    Format format() const { return m_format; }
+    static const char* formatName(Format format);
+    // Конфигурация исходного измерения в той мере, в какой ее хранит формат
+    const PHCConfig& config() const { return m_config; }
+    const std::vector<int>& devices() const { return m_config.devices; }
+    const std::vector<PHCReadMethod>& methods() const { return m_methods; }
+
+    // Передать все итерации приемнику (onStart, onSample..., onStop)
+    bool run(MeasurementSink& sink, std::string& error);
+
+private:
+    bool openText(std::string& error);
+    bool runCSV(MeasurementSink& sink, std::string& error);
+    bool runJSON(MeasurementSink& sink, std::string& error);
+    bool runJSONLines(MeasurementSink& sink, std::string& error);
+
+    std::string m_path;
+    Format m_format = Format::Recording;
+    PHCConfig m_config;
+    std::vector<PHCReadMethod> m_methods;
+    PHCRecordingReader m_recording;
+};
+
+#endif // DIFFPHC_RECORDING_H
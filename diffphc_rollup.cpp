@@ -0,0 +1,304 @@
+#include "diffphc_rollup.h"
+#include <algorithm>
+
+namespace {
+
+constexpr int64_t LEVEL_WIDTH[PHCRollup::LevelCount] = {
+    1000000000LL, 60 * 1000000000LL, 3600 * 1000000000LL
+};
+
+// Начало интервала ширины width, содержащего t (с округлением вниз и для t < 0)
+int64_t bucketStart(int64_t t, int64_t width) {
+    int64_t q = t / width;
+    if (t % width < 0) {
+        q--;
+    }
+    return q * width;
+}
+
+} // namespace
+
+// PHCRollup implementation
+constexpr size_t PHCRollup::DEFAULT_RETENTION[PHCRollup::LevelCount];
+
+PHCRollup::PHCRollup() {
+    for (int level = 0; level < LevelCount; ++level) {
+        m_tiers[level].width = LEVEL_WIDTH[level];
+        m_tiers[level].retention = DEFAULT_RETENTION[level];
+    }
+}
+
+void PHCRollup::reset(size_t numDevices) {
+    m_numDevices = numDevices;
+    for (auto& tier : m_tiers) {
+        tier.buckets.clear();
+        tier.open = PHCRollupBucket();
+        tier.hasOpen = false;
+    }
+}
+
+void PHCRollup::setRetention(Level level, size_t buckets) {
+    auto& tier = m_tiers[level];
+    tier.retention = buckets;
+    while (tier.buckets.size() > tier.retention) {
+        tier.buckets.pop_front();
+    }
+}
+
+void PHCRollup::append(int64_t timestamp, const int64_t* offsets, bool valid) {
+    auto& tier = m_tiers[Second];
+    const int64_t start = bucketStart(timestamp, tier.width);
+    if (tier.hasOpen && start > tier.open.start) {
+        close(Second);
+    }
+    if (!tier.hasOpen) {
+        tier.open.start = start;
+        tier.open.iterations = 0;
+        tier.open.cells.assign(numPairs(), PHCRunningStats());
+        tier.hasOpen = true;
+    }
+
+    tier.open.iterations++;
+    if (!valid) {
+        return;
+    }
+    auto* cell = tier.open.cells.data();
+    for (size_t i = 1; i < m_numDevices; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            (cell++)->add(offsets[i] - offsets[j]);
+        }
+    }
+}
+
+void PHCRollup::onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) {
+    reset(devices.size());
+    (void)methods;
+}
+
+bool PHCRollup::onSample(const PHCSampleView& sample) {
+    if (sample.numDevices == m_numDevices) {
+        append(sample.timestamp, sample.offsets, sample.valid);
+    }
+    return true;
+}
+
+void PHCRollup::flush() {
+    // Мелкий уровень закрывается первым, чтобы его интервал попал в грубый
+    for (int level = Second; level < LevelCount; ++level) {
+        close(Level(level));
+    }
+}
+
+void PHCRollup::close(Level level) {
+    auto& tier = m_tiers[level];
+    if (!tier.hasOpen) {
+        return;
+    }
+    tier.hasOpen = false;
+    if (level + 1 < LevelCount) {
+        merge(Level(level + 1), tier.open);
+    }
+    if (tier.retention == 0) {
+        return;
+    }
+    if (tier.buckets.size() >= tier.retention) {
+        tier.buckets.pop_front();
+    }
+    tier.buckets.push_back(std::move(tier.open));
+}
+
+void PHCRollup::merge(Level level, const PHCRollupBucket& bucket) {
+    auto& tier = m_tiers[level];
+    const int64_t start = bucketStart(bucket.start, tier.width);
+    if (tier.hasOpen && start > tier.open.start) {
+        close(level);
+    }
+    if (!tier.hasOpen) {
+        tier.open.start = start;
+        tier.open.iterations = 0;
+        tier.open.cells.assign(numPairs(), PHCRunningStats());
+        tier.hasOpen = true;
+    }
+    tier.open.iterations += bucket.iterations;
+    for (size_t p = 0; p < bucket.cells.size(); ++p) {
+        tier.open.cells[p].merge(bucket.cells[p]);
+    }
+}
+
+PHCRollup::Level PHCRollup::levelFor(int64_t resolution) const {
+    for (int level = LevelCount - 1; level > Second; --level) {
+        if (m_tiers[level].width <= resolution) {
+            return Level(level);
+        }
+    }
+    return Second;
+}
+
+void PHCRollup::query(Level level, int64_t from, int64_t to,
+                      std::vector<const PHCRollupBucket*>& out) const {
+    out.clear();
+    const auto& tier = m_tiers[level];
+    auto it = std::lower_bound(tier.buckets.begin(), tier.buckets.end(), from,
+                               [&](const PHCRollupBucket& bucket, int64_t t) {
+                                   return bucket.start + tier.width <= t;
+                               });
+    for (; it != tier.buckets.end() && it->start <= to; ++it) {
+        out.push_back(&*it);
+    }
+    if (tier.hasOpen && tier.open.start <= to && tier.open.start + tier.width > from) {
+        out.push_back(&tier.open);
+    }
+}
+
+PHCRunningStats PHCRollup::summarize(size_t i, size_t j, int64_t from, int64_t to,
+                                   int64_t resolution) const {
+    PHCRunningStats total;
+    std::vector<const PHCRollupBucket*> buckets;
+    query(levelFor(resolution), from, to, buckets);
+    const size_t p = pairIndex(std::max(i, j), std::min(i, j));
+    for (const auto* bucket : buckets) {
+        PHCRunningStats cell = bucket->cells[p];
+        if (i < j) {
+            // Разность (j, i) с обратным знаком
+            std::swap(cell.minimum, cell.maximum);
+            cell.minimum = -cell.minimum;
+            cell.maximum = -cell.maximum;
+            cell.mean = -cell.mean;
+        }
+        total.merge(cell);
+    }
+    return total;
+}
+
+// PHCSlidingStats implementation
+constexpr int64_t PHCSlidingStats::DEFAULT_WIDTHS[PHCSlidingStats::DEFAULT_WINDOW_COUNT];
+
+PHCSlidingStats::PHCSlidingStats()
+    : PHCSlidingStats(std::vector<int64_t>(DEFAULT_WIDTHS, DEFAULT_WIDTHS + DEFAULT_WINDOW_COUNT)) {
+}
+
+PHCSlidingStats::PHCSlidingStats(const std::vector<int64_t>& widths) {
+    for (int64_t width : widths) {
+        Window window;
+        window.width = width;
+        m_windows.push_back(std::move(window));
+    }
+}
+
+void PHCSlidingStats::reset(size_t numDevices) {
+    m_numDevices = numDevices;
+    m_first = m_next = 0;
+    m_timestamps.clear();
+    m_values.clear();
+    m_reference.clear();
+    for (auto& window : m_windows) {
+        window.head = 0;
+        window.cells.assign(numPairs(), Cell());
+    }
+}
+
+void PHCSlidingStats::append(int64_t timestamp, const PHCPairView& pairs, bool valid) {
+    if (!valid || m_numDevices < 2) {
+        return;
+    }
+    const size_t count = numPairs();
+    if (m_reference.empty()) {
+        for (size_t i = 1; i < m_numDevices; ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                m_reference.push_back(pairs(i, j));
+            }
+        }
+    }
+    const uint64_t row = m_next++;
+    m_timestamps.push_back(timestamp);
+    for (size_t i = 1, p = 0; i < m_numDevices; ++i) {
+        for (size_t j = 0; j < i; ++j, ++p) {
+            m_values.push_back(pairs(i, j) - m_reference[p]);
+        }
+    }
+
+    uint64_t oldest = row;
+    for (auto& window : m_windows) {
+        for (size_t p = 0; p < count; ++p) {
+            auto& cell = window.cells[p];
+            const int64_t x = value(row, p);
+            cell.sum += x;
+            cell.squares += __int128(x) * x;
+            while (!cell.minimum.empty() && value(cell.minimum.back(), p) >= x) {
+                cell.minimum.pop_back();
+            }
+            cell.minimum.push_back(row);
+            while (!cell.maximum.empty() && value(cell.maximum.back(), p) <= x) {
+                cell.maximum.pop_back();
+            }
+            cell.maximum.push_back(row);
+        }
+
+        // Окно - итерации с метками в (timestamp - width, timestamp]
+        while (window.head < row && m_timestamps[window.head - m_first] <= timestamp - window.width) {
+            for (size_t p = 0; p < count; ++p) {
+                auto& cell = window.cells[p];
+                const int64_t x = value(window.head, p);
+                cell.sum -= x;
+                cell.squares -= __int128(x) * x;
+                if (cell.minimum.front() == window.head) {
+                    cell.minimum.pop_front();
+                }
+                if (cell.maximum.front() == window.head) {
+                    cell.maximum.pop_front();
+                }
+            }
+            window.head++;
+        }
+        oldest = std::min(oldest, window.head);
+    }
+
+    while (m_first < oldest) {
+        m_timestamps.pop_front();
+        m_values.erase(m_values.begin(), m_values.begin() + count);
+        m_first++;
+    }
+}
+
+void PHCSlidingStats::onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) {
+    reset(devices.size());
+    (void)methods;
+}
+
+bool PHCSlidingStats::onSample(const PHCSampleView& sample) {
+    if (sample.numDevices == m_numDevices) {
+        append(sample.timestamp, sample.pairs(), sample.valid);
+    }
+    return true;
+}
+
+PHCRunningStats PHCSlidingStats::statistics(size_t window, size_t i, size_t j) const {
+    PHCRunningStats stats;
+    const auto& w = m_windows[window];
+    if (i == j || m_next == 0) {
+        return stats;
+    }
+    const size_t p = PHCRollup::pairIndex(std::max(i, j), std::min(i, j));
+    const auto& cell = w.cells[p];
+    const int64_t reference = m_reference[p];
+    stats.count = m_next - w.head;
+    stats.minimum = reference + value(cell.minimum.front(), p);
+    stats.maximum = reference + value(cell.maximum.front(), p);
+
+    // Σ(x - mean)² через целое q = ⌊sum / n⌋: Σ(x - q)² - r²/n, r = sum - q·n
+    const __int128 n = stats.count;
+    const __int128 q = cell.sum / n;
+    const __int128 r = cell.sum - q * n;
+    const __int128 deviations = cell.squares - 2 * q * cell.sum + q * q * n;
+    stats.mean = reference + double(q) + double(r) / double(n);
+    stats.m2 = std::max(0.0, double(deviations) - double(r) * double(r) / double(n));
+
+    if (i < j) {
+        // Разность (j, i) с обратным знаком
+        std::swap(stats.minimum, stats.maximum);
+        stats.minimum = -stats.minimum;
+        stats.maximum = -stats.maximum;
+        stats.mean = -stats.mean;
+    }
+    return stats;
+}
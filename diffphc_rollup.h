@@ -0,0 +1,134 @@
+#ifndef DIFFPHC_ROLLUP_H
+#define DIFFPHC_ROLLUP_H
+
+#include "diffphc_core.h"
+#include <deque>
+
+// Интервал уровня: начало и агрегат каждой пары (i > j). Агрегаты
+// соседних интервалов сливаются без исходных значений (формула Чана),
+// поэтому грубые уровни строятся из закрытых интервалов более мелкого.
+struct PHCRollupBucket {
+    int64_t start = 0;          // Начало интервала (CLOCK_REALTIME, нс)
+    uint64_t iterations = 0;    // Итераций в интервале, включая итерации с ошибкой
+    std::vector<PHCRunningStats> cells;   // По PHCRollup::pairIndex(i, j)
+};
+
+// Уровень агрегации: закрытые интервалы одной длительности, не более
+// retention последних, и открытый интервал, который еще пополняется
+struct PHCRollupTier {
+    int64_t width = 0;          // Длительность интервала (нс)
+    size_t retention = 0;       // Хранимых закрытых интервалов
+    std::deque<PHCRollupBucket> buckets;
+    PHCRollupBucket open;
+    bool hasOpen = false;
+};
+
+// Многоуровневая агрегация длительного измерения: по секундам, минутам
+// и часам. Каждая итерация обновляет только секундный интервал; при его
+// закрытии агрегат сливается в минутный, минутный - в часовой. Запросы
+// за длинный период читают самый грубый уровень, которого достаточно
+// для требуемого разрешения, не обращаясь к сырым итерациям. Открытый
+// интервал грубого уровня еще не содержит открытого интервала более
+// мелкого уровня.
+class PHCRollup : public MeasurementSink {
+public:
+    enum Level { Second = 0, Minute, Hour, LevelCount };
+
+    // Хранимые интервалы по умолчанию: час секунд, неделя минут, год часов
+    static constexpr size_t DEFAULT_RETENTION[LevelCount] = {3600, 7 * 24 * 60, 365 * 24};
+
+    PHCRollup();
+
+    // Очистить и задать число устройств
+    void reset(size_t numDevices);
+    void setRetention(Level level, size_t buckets);
+    void append(int64_t timestamp, const int64_t* offsets, bool valid);
+    void onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) override;
+    bool onSample(const PHCSampleView& sample) override;
+    void onStop() override { flush(); }
+    // Закрыть открытые интервалы всех уровней (конец измерения)
+    void flush();
+
+    size_t numDevices() const { return m_numDevices; }
+    size_t numPairs() const { return m_numDevices * (m_numDevices - 1) / 2; }
+    // Индекс пары i > j в PHCRollupBucket::cells
+    static size_t pairIndex(size_t i, size_t j) { return i * (i - 1) / 2 + j; }
+
+    const PHCRollupTier& tier(Level level) const { return m_tiers[level]; }
+    // Самый грубый уровень с интервалом не длиннее resolution (нс)
+    Level levelFor(int64_t resolution) const;
+
+    // Интервалы уровня, пересекающие [from, to], включая открытый
+    void query(Level level, int64_t from, int64_t to, std::vector<const PHCRollupBucket*>& out) const;
+    // Агрегат пары (i, j) за [from, to] по уровню для разрешения resolution
+    PHCRunningStats summarize(size_t i, size_t j, int64_t from, int64_t to, int64_t resolution) const;
+
+private:
+    void close(Level level);
+    void merge(Level level, const PHCRollupBucket& bucket);
+
+    size_t m_numDevices = 0;
+    PHCRollupTier m_tiers[LevelCount];
+};
+
+// Скользящие окна: статистика каждой пары (i > j) за последние 1 с,
+// 1 мин и 1 ч (или заданные длительности) по меткам времени итераций,
+// все окна сразу. Итерации хранятся одной очередью на длину самого
+// длинного окна; каждое окно ведет свое начало в ней, суммы разностей и их
+// квадратов (вычитание при вытеснении) и монотонные очереди минимума и
+// максимума. Итерация стоит O(1) амортизированно на окно и пару, запрос -
+// O(1), история заново не просматривается. Суммы целочисленные (128 бит,
+// относительно первого значения пары), поэтому вычитание не накапливает
+// ошибку округления. Итерации с ошибкой чтения пропускаются.
+class PHCSlidingStats : public MeasurementSink {
+public:
+    static constexpr size_t DEFAULT_WINDOW_COUNT = 3;
+    // Окна по умолчанию: 1 с, 1 мин, 1 ч (нс)
+    static constexpr int64_t DEFAULT_WIDTHS[DEFAULT_WINDOW_COUNT] = {
+        1000000000LL, 60 * 1000000000LL, 3600 * 1000000000LL
+    };
+
+    PHCSlidingStats();
+    // Длительности окон (нс), по возрастанию
+    explicit PHCSlidingStats(const std::vector<int64_t>& widths);
+
+    // Очистить и задать число устройств
+    void reset(size_t numDevices);
+    void append(int64_t timestamp, const PHCPairView& pairs, bool valid);
+    void onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) override;
+    bool onSample(const PHCSampleView& sample) override;
+
+    size_t numDevices() const { return m_numDevices; }
+    size_t windowCount() const { return m_windows.size(); }
+    int64_t width(size_t window) const { return m_windows[window].width; }
+    // Метка времени последней итерации без ошибки
+    int64_t lastTimestamp() const { return m_timestamps.empty() ? 0 : m_timestamps.back(); }
+    // Статистика разности (i, j) за окно, заканчивающееся последней итерацией
+    PHCRunningStats statistics(size_t window, size_t i, size_t j) const;
+
+private:
+    struct Cell {
+        __int128 sum = 0;               // Сумма разностей относительно m_reference
+        __int128 squares = 0;           // Сумма их квадратов
+        std::deque<uint64_t> minimum;   // Номера итераций с возрастающей разностью
+        std::deque<uint64_t> maximum;   // Номера итераций с убывающей разностью
+    };
+    struct Window {
+        int64_t width;
+        uint64_t head = 0;              // Номер первой итерации окна
+        std::vector<Cell> cells;        // По PHCRollup::pairIndex(i, j)
+    };
+
+    size_t numPairs() const { return m_numDevices * (m_numDevices - 1) / 2; }
+    int64_t value(uint64_t row, size_t pair) const { return m_values[(row - m_first) * numPairs() + pair]; }
+
+    size_t m_numDevices = 0;
+    uint64_t m_first = 0;               // Номер самой старой хранимой итерации
+    uint64_t m_next = 0;                // Номер следующей итерации
+    std::deque<int64_t> m_timestamps;   // Метки хранимых итераций
+    std::deque<int64_t> m_values;       // Разности пар относительно m_reference, по итерациям
+    std::vector<int64_t> m_reference;   // Первая разность каждой пары
+    std::vector<Window> m_windows;
+};
+
+#endif // DIFFPHC_ROLLUP_H
@@ -0,0 +1,547 @@
+#include "diffphc_stability.h"
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+
+PHCStabilityPoint makePoint(uint64_t m, double tau0, double adevSum, uint64_t adevTerms,
+                            double mdevSum, uint64_t mdevTerms) {
+    PHCStabilityPoint point;
+    const double tau = m * tau0;
+    point.factor = m;
+    point.tau = tau / 1e9;
+    point.adev = std::sqrt(adevSum / (2 * tau * tau * adevTerms));
+    point.mdev = std::sqrt(mdevSum / (2.0 * m * m * tau * tau * mdevTerms));
+    point.tdev = tau / std::sqrt(3.0) * point.mdev;
+    point.terms = mdevTerms;
+    return point;
+}
+
+uint64_t roundUpPow2(uint64_t value) {
+    uint64_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// MTIE интервала m по всему массиву; очереди - кольца индексов емкостью
+// 2^k >= m + 2 (окно из m + 1 индексов и новый до вытеснения старого)
+int64_t windowedRange(const int64_t* x, size_t n, uint64_t m) {
+    const uint64_t mask = roundUpPow2(m + 2) - 1;
+    std::vector<uint64_t> minimum(mask + 1), maximum(mask + 1);
+    uint64_t minHead = 0, minTail = 0, maxHead = 0, maxTail = 0;
+    int64_t result = 0;
+    for (uint64_t k = 0; k < n; ++k) {
+        while (minTail > minHead && x[minimum[(minTail - 1) & mask]] >= x[k]) {
+            minTail--;
+        }
+        minimum[minTail++ & mask] = k;
+        while (maxTail > maxHead && x[maximum[(maxTail - 1) & mask]] <= x[k]) {
+            maxTail--;
+        }
+        maximum[maxTail++ & mask] = k;
+        if (k < m) {
+            continue;
+        }
+        // Окно [k - m, k]
+        if (minimum[minHead & mask] < k - m) {
+            minHead++;
+        }
+        if (maximum[maxHead & mask] < k - m) {
+            maxHead++;
+        }
+        result = std::max(result, x[maximum[maxHead & mask]] - x[minimum[minHead & mask]]);
+    }
+    return result;
+}
+
+// Суммы ADEV/MDEV октавы m = 2^k по всем отрезкам
+struct OctaveSums {
+    double adevSum = 0.0;
+    uint64_t adevTerms = 0;
+    double mdevSum = 0.0;
+    uint64_t mdevTerms = 0;
+};
+
+// Добавить к sums слагаемые отрезка x[0..n)
+void accumulateSegment(const int64_t* phase, size_t n, uint64_t maxFactor, std::vector<OctaveSums>& sums,
+                       std::vector<__int128>& prefix) {
+    if (n < 3) {
+        return;
+    }
+    // Префиксные суммы фазы относительно первого значения; 128 бит, чтобы
+    // сумма за сутки измерений не переполнялась
+    prefix.resize(n + 1);
+    prefix[0] = 0;
+    for (size_t i = 0; i < n; ++i) {
+        prefix[i + 1] = prefix[i] + (phase[i] - phase[0]);
+    }
+
+    size_t k = 0;
+    for (uint64_t m = 1; 2 * m < n && (maxFactor == 0 || m <= maxFactor); m *= 2, ++k) {
+        if (sums.size() <= k) {
+            sums.resize(k + 1);
+        }
+        OctaveSums& octave = sums[k];
+        for (size_t i = 0; i + 2 * m < n; ++i) {
+            const double d2 = double(phase[i + 2 * m] - 2 * phase[i + m] + phase[i]);
+            octave.adevSum += d2 * d2;
+        }
+        octave.adevTerms += n - 2 * m;
+        if (3 * m > n) {
+            continue;
+        }
+        // Сумма m вторых разностей, начиная с j:
+        // S[j+3m] - 3S[j+2m] + 3S[j+m] - S[j]
+        for (size_t j = 0; j + 3 * m <= n; ++j) {
+            const double inner = double(prefix[j + 3 * m] - 3 * prefix[j + 2 * m] +
+                                        3 * prefix[j + m] - prefix[j]);
+            octave.mdevSum += inner * inner;
+        }
+        octave.mdevTerms += n - 3 * m + 1;
+    }
+}
+
+void stabilityCurve(const int64_t* phase, const size_t* starts, size_t segments, double tau0,
+                    std::vector<PHCStabilityPoint>& out, uint64_t maxFactor) {
+    out.clear();
+    std::vector<OctaveSums> sums;
+    std::vector<__int128> prefix;
+    for (size_t s = 0; s < segments; ++s) {
+        accumulateSegment(phase + starts[s], starts[s + 1] - starts[s], maxFactor, sums, prefix);
+    }
+    uint64_t m = 1;
+    for (const auto& octave : sums) {
+        if (octave.mdevTerms == 0) {
+            break;
+        }
+        out.push_back(makePoint(m, tau0, octave.adevSum, octave.adevTerms, octave.mdevSum, octave.mdevTerms));
+        m *= 2;
+    }
+}
+
+PHCMtiePoint makeMtiePoint(uint64_t m, double tau0, int64_t mtie, uint64_t windows) {
+    PHCMtiePoint point;
+    point.factor = m;
+    point.tau = m * tau0 / 1e9;
+    point.mtie = mtie;
+    point.windows = windows;
+    return point;
+}
+
+// MTIE по отрезкам x[starts[s]..starts[s+1]): окна интервала m берутся
+// внутри отрезков длиннее m, интервалы независимы и считаются параллельно
+void mtieCurve(const int64_t* phase, const size_t* starts, size_t segments, double tau0,
+               std::vector<PHCMtiePoint>& out, uint64_t maxFactor, unsigned threads) {
+    out.clear();
+    size_t longest = 0;
+    for (size_t s = 0; s < segments; ++s) {
+        longest = std::max(longest, starts[s + 1] - starts[s]);
+    }
+    for (uint64_t m = 1; m < longest && (maxFactor == 0 || m <= maxFactor); m *= 2) {
+        uint64_t windows = 0;
+        for (size_t s = 0; s < segments; ++s) {
+            const size_t n = starts[s + 1] - starts[s];
+            windows += n > m ? n - m : 0;
+        }
+        out.push_back(makeMtiePoint(m, tau0, 0, windows));
+    }
+    if (out.empty()) {
+        return;
+    }
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min<unsigned>(threads, out.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t k = next++; k < out.size(); k = next++) {
+            for (size_t s = 0; s < segments; ++s) {
+                const size_t n = starts[s + 1] - starts[s];
+                if (n > out[k].factor) {
+                    out[k].mtie = std::max(out[k].mtie, windowedRange(phase + starts[s], n, out[k].factor));
+                }
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+} // namespace
+
+// PHCGapDetector implementation
+void PHCGapDetector::reset(double tau0) {
+    m_tau0 = tau0;
+    m_last = 0;
+    m_started = false;
+    m_broken = false;
+    m_gaps = 0;
+}
+
+bool PHCGapDetector::next(int64_t timestamp, bool valid) {
+    if (!valid) {
+        m_broken = m_broken || m_started;
+        return false;
+    }
+    const bool gap = m_broken ||
+                     (m_started && m_tau0 > 0 && double(timestamp - m_last) > PHC_PHASE_GAP_FACTOR * m_tau0);
+    m_started = true;
+    m_broken = false;
+    m_last = timestamp;
+    if (gap) {
+        m_gaps++;
+    }
+    return gap;
+}
+
+// PHCPhaseSegments implementation
+void PHCPhaseSegments::build(const PHCSeries& series, size_t i, size_t j, double tau0) {
+    phase.clear();
+    starts.clear();
+    PHCGapDetector detector;
+    detector.reset(tau0);
+    for (size_t row = 0; row < series.size(); ++row) {
+        const bool valid = series.valid(row);
+        if (detector.next(series.timestamp(row), valid) || (valid && phase.empty())) {
+            starts.push_back(phase.size());
+        }
+        if (valid) {
+            phase.push_back(series.offset(row, i) - series.offset(row, j));
+        }
+    }
+    starts.push_back(phase.size());
+    gaps = detector.gaps();
+}
+
+// PHCStability implementation
+void PHCStability::compute(const int64_t* phase, size_t n, double tau0,
+                           std::vector<PHCStabilityPoint>& out, uint64_t maxFactor) {
+    const size_t starts[2] = {0, n};
+    stabilityCurve(phase, starts, 1, tau0, out, maxFactor);
+}
+
+void PHCStability::compute(const PHCPhaseSegments& segments, double tau0,
+                           std::vector<PHCStabilityPoint>& out, uint64_t maxFactor) {
+    stabilityCurve(segments.phase.data(), segments.starts.data(), segments.segments(), tau0, out, maxFactor);
+}
+
+// PHCStabilityAccumulator implementation
+PHCStabilityAccumulator::PHCStabilityAccumulator(uint64_t maxFactor)
+    : m_maxFactor(roundUpPow2(std::max<uint64_t>(1, maxFactor))) {
+    m_phase.assign(roundUpPow2(2 * m_maxFactor + 1), 0);
+    for (uint64_t m = 1; m <= m_maxFactor; m *= 2) {
+        Octave octave;
+        octave.factor = m;
+        m_octaves.push_back(std::move(octave));
+    }
+}
+
+void PHCStabilityAccumulator::reset(double tau0) {
+    m_tau0 = tau0;
+    m_count = 0;
+    m_segmentStart = 0;
+    m_origin = 0;
+    for (auto& octave : m_octaves) {
+        octave.adevSum = 0.0;
+        octave.adevTerms = 0;
+        octave.run = 0;
+        octave.windowSum = 0;
+        octave.mdevSum = 0.0;
+        octave.mdevTerms = 0;
+    }
+}
+
+void PHCStabilityAccumulator::add(int64_t phase) {
+    if (m_count == 0) {
+        m_origin = phase;
+    }
+    const int64_t x = phase - m_origin;
+    const uint64_t n = m_count++;
+    m_phase[n & (m_phase.size() - 1)] = x;
+
+    for (auto& octave : m_octaves) {
+        const uint64_t m = octave.factor;
+        if (n - m_segmentStart < 2 * m) {
+            break;
+        }
+        const int64_t d2 = x - 2 * phaseAt(n - m) + phaseAt(n - 2 * m);
+        octave.adevSum += double(d2) * double(d2);
+
+        // Окно из m последних вторых разностей; буфер выделяется при первой
+        if (octave.window.empty()) {
+            octave.window.assign(m, 0);
+        }
+        int64_t& slot = octave.window[octave.run & (m - 1)];
+        if (octave.run >= m) {
+            octave.windowSum -= slot;
+        }
+        slot = d2;
+        octave.windowSum += d2;
+        octave.adevTerms++;
+        octave.run++;
+        if (octave.run >= m) {
+            octave.mdevSum += double(octave.windowSum) * double(octave.windowSum);
+            octave.mdevTerms++;
+        }
+    }
+}
+
+void PHCStabilityAccumulator::gap() {
+    m_segmentStart = m_count;
+    for (auto& octave : m_octaves) {
+        octave.run = 0;
+        octave.windowSum = 0;
+    }
+}
+
+void PHCStabilityAccumulator::curve(std::vector<PHCStabilityPoint>& out) const {
+    out.clear();
+    for (const auto& octave : m_octaves) {
+        if (octave.mdevTerms == 0) {
+            break;
+        }
+        out.push_back(makePoint(octave.factor, m_tau0, octave.adevSum, octave.adevTerms,
+                                octave.mdevSum, octave.mdevTerms));
+    }
+}
+
+// PHCStabilitySink implementation
+void PHCStabilitySink::reset(size_t numDevices) {
+    m_numDevices = numDevices;
+    m_gaps.reset(m_tau0);
+    const size_t pairs = numDevices > 1 ? numDevices * (numDevices - 1) / 2 : 0;
+    m_pairs.assign(pairs, PHCStabilityAccumulator(m_maxFactor));
+    for (auto& pair : m_pairs) {
+        pair.reset(m_tau0);
+    }
+}
+
+void PHCStabilitySink::append(int64_t timestamp, const int64_t* offsets, bool valid) {
+    if (m_gaps.next(timestamp, valid)) {
+        for (auto& pair : m_pairs) {
+            pair.gap();
+        }
+    }
+    if (!valid) {
+        return;
+    }
+    auto* pair = m_pairs.data();
+    for (size_t i = 1; i < m_numDevices; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            (pair++)->add(offsets[i] - offsets[j]);
+        }
+    }
+}
+
+void PHCStabilitySink::onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) {
+    reset(devices.size());
+    (void)methods;
+}
+
+bool PHCStabilitySink::onSample(const PHCSampleView& sample) {
+    if (sample.numDevices == m_numDevices) {
+        append(sample.timestamp, sample.offsets, sample.valid);
+    }
+    return true;
+}
+
+void PHCStabilitySink::curve(size_t i, size_t j, std::vector<PHCStabilityPoint>& out) const {
+    m_pairs[i * (i - 1) / 2 + j].curve(out);
+}
+
+// PHCMtieMask implementation
+bool PHCMtieMask::parse(const std::string& spec, std::string& error) {
+    m_points.clear();
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos) {
+            end = spec.size();
+        }
+        const std::string item = spec.substr(pos, end - pos);
+        const size_t colon = item.find(':');
+        char* tauEnd = nullptr;
+        char* limitEnd = nullptr;
+        const double tau = colon == std::string::npos ? 0.0 : std::strtod(item.c_str(), &tauEnd);
+        const double limit = colon == std::string::npos ? 0.0 : std::strtod(item.c_str() + colon + 1, &limitEnd);
+        if (colon == std::string::npos || tauEnd != item.c_str() + colon || *limitEnd != '\0' ||
+            !(tau > 0) || !(limit > 0)) {
+            error = "Invalid MTIE mask point '" + item + "' (expected TAU:NS with positive values)";
+            m_points.clear();
+            return false;
+        }
+        if (!m_points.empty() && tau < m_points.back().first) {
+            error = "MTIE mask points must be ordered by tau";
+            m_points.clear();
+            return false;
+        }
+        m_points.emplace_back(tau, limit);
+        pos = end + 1;
+    }
+    return true;
+}
+
+double PHCMtieMask::limit(double tau) const {
+    if (m_points.empty() || tau < m_points.front().first) {
+        return 0.0;
+    }
+    for (size_t k = 0; k + 1 < m_points.size(); ++k) {
+        const auto& a = m_points[k];
+        const auto& b = m_points[k + 1];
+        if (tau <= b.first) {
+            if (b.first == a.first) {
+                return a.second;
+            }
+            return a.second + (b.second - a.second) * (tau - a.first) / (b.first - a.first);
+        }
+    }
+    return m_points.back().second;
+}
+
+bool PHCMtieMask::apply(std::vector<PHCMtiePoint>& curve) const {
+    bool passed = true;
+    for (auto& point : curve) {
+        point.limit = limit(point.tau);
+        point.pass = point.limit == 0.0 || point.mtie <= point.limit;
+        passed = passed && point.pass;
+    }
+    return passed;
+}
+
+// PHCMtie implementation
+void PHCMtie::compute(const int64_t* phase, size_t n, double tau0, std::vector<PHCMtiePoint>& out,
+                      uint64_t maxFactor, unsigned threads) {
+    const size_t starts[2] = {0, n};
+    mtieCurve(phase, starts, 1, tau0, out, maxFactor, threads);
+}
+
+void PHCMtie::compute(const PHCPhaseSegments& segments, double tau0, std::vector<PHCMtiePoint>& out,
+                      uint64_t maxFactor, unsigned threads) {
+    mtieCurve(segments.phase.data(), segments.starts.data(), segments.segments(), tau0, out, maxFactor, threads);
+}
+
+// PHCMtieAccumulator implementation
+PHCMtieAccumulator::PHCMtieAccumulator(uint64_t maxFactor)
+    : m_maxFactor(roundUpPow2(std::max<uint64_t>(1, maxFactor))) {
+    m_phase.assign(roundUpPow2(m_maxFactor + 2), 0);
+    for (uint64_t m = 1; m <= m_maxFactor; m *= 2) {
+        Interval interval;
+        interval.factor = m;
+        m_intervals.push_back(std::move(interval));
+    }
+}
+
+void PHCMtieAccumulator::reset(double tau0) {
+    m_tau0 = tau0;
+    m_count = 0;
+    m_segmentStart = 0;
+    for (auto& interval : m_intervals) {
+        interval.minimum.clear();
+        interval.maximum.clear();
+        interval.mtie = 0;
+        interval.windows = 0;
+    }
+}
+
+void PHCMtieAccumulator::add(int64_t phase) {
+    const uint64_t k = m_count++;
+    m_phase[k & (m_phase.size() - 1)] = phase;
+
+    for (auto& interval : m_intervals) {
+        auto& minimum = interval.minimum;
+        auto& maximum = interval.maximum;
+        while (!minimum.empty() && phaseAt(minimum.back()) >= phase) {
+            minimum.pop_back();
+        }
+        minimum.push_back(k);
+        while (!maximum.empty() && phaseAt(maximum.back()) <= phase) {
+            maximum.pop_back();
+        }
+        maximum.push_back(k);
+
+        const uint64_t m = interval.factor;
+        if (k - m_segmentStart < m) {
+            continue;
+        }
+        if (minimum.front() < k - m) {
+            minimum.pop_front();
+        }
+        if (maximum.front() < k - m) {
+            maximum.pop_front();
+        }
+        interval.mtie = std::max(interval.mtie, phaseAt(maximum.front()) - phaseAt(minimum.front()));
+        interval.windows++;
+    }
+}
+
+void PHCMtieAccumulator::gap() {
+    m_segmentStart = m_count;
+    for (auto& interval : m_intervals) {
+        interval.minimum.clear();
+        interval.maximum.clear();
+    }
+}
+
+void PHCMtieAccumulator::curve(std::vector<PHCMtiePoint>& out) const {
+    out.clear();
+    for (const auto& interval : m_intervals) {
+        if (interval.windows == 0) {
+            break;
+        }
+        out.push_back(makeMtiePoint(interval.factor, m_tau0, interval.mtie, interval.windows));
+    }
+}
+
+// PHCMtieSink implementation
+void PHCMtieSink::reset(size_t numDevices) {
+    m_numDevices = numDevices;
+    m_gaps.reset(m_tau0);
+    const size_t pairs = numDevices > 1 ? numDevices * (numDevices - 1) / 2 : 0;
+    m_pairs.assign(pairs, PHCMtieAccumulator(m_maxFactor));
+    for (auto& pair : m_pairs) {
+        pair.reset(m_tau0);
+    }
+}
+
+void PHCMtieSink::append(int64_t timestamp, const int64_t* offsets, bool valid) {
+    if (m_gaps.next(timestamp, valid)) {
+        for (auto& pair : m_pairs) {
+            pair.gap();
+        }
+    }
+    if (!valid) {
+        return;
+    }
+    auto* pair = m_pairs.data();
+    for (size_t i = 1; i < m_numDevices; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            (pair++)->add(offsets[i] - offsets[j]);
+        }
+    }
+}
+
+void PHCMtieSink::onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) {
+    reset(devices.size());
+    (void)methods;
+}
+
+bool PHCMtieSink::onSample(const PHCSampleView& sample) {
+    if (sample.numDevices == m_numDevices) {
+        append(sample.timestamp, sample.offsets, sample.valid);
+    }
+    return true;
+}
+
+void PHCMtieSink::curve(size_t i, size_t j, std::vector<PHCMtiePoint>& out) const {
+    m_pairs[i * (i - 1) / 2 + j].curve(out);
+}
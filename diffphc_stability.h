@@ -0,0 +1,260 @@
+#ifndef DIFFPHC_STABILITY_H
+#define DIFFPHC_STABILITY_H
+
+#include "diffphc_core.h"
+#include <deque>
+
+// Точка кривой стабильности для τ = factor·τ0. Фазовые данные - разность
+// пары устройств в наносекундах, ADEV и MDEV безразмерные (относительная
+// частота), TDEV - в наносекундах.
+struct PHCStabilityPoint {
+    uint64_t factor = 0;        // Интервал усреднения в шагах τ0
+    double tau = 0.0;           // Интервал усреднения (с)
+    double adev = 0.0;          // Девиация Аллана, перекрывающаяся оценка
+    double mdev = 0.0;          // Модифицированная девиация Аллана
+    double tdev = 0.0;          // Временная девиация (нс)
+    uint64_t terms = 0;         // Слагаемых в оценке MDEV (N - 3m + 1)
+};
+
+// Шаг меток времени больше PHC_PHASE_GAP_FACTOR·τ0 - пропущенные точки сетки
+constexpr double PHC_PHASE_GAP_FACTOR = 1.5;
+
+// Разрывы фазовых данных: итерация с ошибкой чтения или шаг меток времени
+// больше PHC_PHASE_GAP_FACTOR·τ0 (пропущенный дедлайн). Фазу по обе
+// стороны разрыва нельзя считать отсчетами с шагом τ0: τ оценок через
+// разрыв было бы меньше реального интервала
+class PHCGapDetector {
+public:
+    // tau0 - интервал сетки (нс); 0 - разрывы только по ошибкам чтения
+    void reset(double tau0);
+    // Очередная итерация; true, если она принята и начинает новый
+    // отрезок после разрыва
+    bool next(int64_t timestamp, bool valid);
+    uint64_t gaps() const { return m_gaps; }
+
+private:
+    double m_tau0 = 0.0;
+    int64_t m_last = 0;
+    bool m_started = false;     // Была принятая итерация
+    bool m_broken = false;      // После нее были итерации с ошибкой
+    uint64_t m_gaps = 0;
+};
+
+// Фаза пары по хранимым итерациям, разбитая на отрезки без разрывов
+struct PHCPhaseSegments {
+    std::vector<int64_t> phase;     // Фаза принятых итераций подряд
+    std::vector<size_t> starts;     // Начала отрезков в phase, последний элемент - phase.size()
+    uint64_t gaps = 0;              // Разрывов между отрезками
+
+    size_t segments() const { return starts.empty() ? 0 : starts.size() - 1; }
+    // Фаза пары i > j; tau0 - интервал сетки (нс)
+    void build(const PHCSeries& series, size_t i, size_t j, double tau0);
+};
+
+// Девиации Аллана по фазовым данным x[0..N) с шагом τ0 для октавных
+// интервалов τ = m·τ0, m = 1, 2, 4, ... (пока N - 3m + 1 > 0):
+//
+//   ADEV²(τ) = Σ (x[i+2m] - 2x[i+m] + x[i])² / (2τ²(N - 2m))
+//   MDEV²(τ) = Σ_j (Σ_{i=j..j+m-1} (x[i+2m] - 2x[i+m] + x[i]))² / (2m²τ²(N - 3m + 1))
+//   TDEV(τ)  = τ/√3 · MDEV(τ)
+//
+// Внутренние суммы MDEV берутся по префиксным суммам фазы, поэтому каждый
+// интервал стоит O(N), вся кривая - O(N log N).
+class PHCStability {
+public:
+    // tau0 - шаг фазовых данных (нс); maxFactor - наибольший m (0 - без ограничения)
+    static void compute(const int64_t* phase, size_t n, double tau0,
+                        std::vector<PHCStabilityPoint>& out, uint64_t maxFactor = 0);
+    static void compute(const std::vector<int64_t>& phase, double tau0,
+                        std::vector<PHCStabilityPoint>& out, uint64_t maxFactor = 0) {
+        compute(phase.data(), phase.size(), tau0, out, maxFactor);
+    }
+    // По отрезкам без разрывов: слагаемые берутся только внутри отрезков
+    // и суммируются по всем, terms - их общее число
+    static void compute(const PHCPhaseSegments& segments, double tau0,
+                        std::vector<PHCStabilityPoint>& out, uint64_t maxFactor = 0);
+};
+
+// Потоковый расчет тех же оценок: каждое значение фазы обновляет суммы
+// всех октавных интервалов до maxFactor за O(log maxFactor). Хранятся
+// только последние 2·maxFactor значений фазы и по m последних вторых
+// разностей для каждого m, поэтому память не зависит от длительности.
+class PHCStabilityAccumulator {
+public:
+    static constexpr uint64_t DEFAULT_MAX_FACTOR = uint64_t(1) << 14;
+
+    explicit PHCStabilityAccumulator(uint64_t maxFactor = DEFAULT_MAX_FACTOR);
+
+    // Очистить; tau0 - шаг фазовых данных (нс)
+    void reset(double tau0);
+    void add(int64_t phase);
+    // Разрыв: следующие слагаемые не опираются на фазу до него
+    void gap();
+    uint64_t count() const { return m_count; }
+    void curve(std::vector<PHCStabilityPoint>& out) const;
+
+private:
+    struct Octave {
+        uint64_t factor;
+        double adevSum = 0.0;           // Сумма квадратов вторых разностей
+        uint64_t adevTerms = 0;
+        uint64_t run = 0;               // Вторых разностей с начала отрезка
+        std::vector<int64_t> window;    // Последние factor вторых разностей (кольцо)
+        int64_t windowSum = 0;
+        double mdevSum = 0.0;           // Сумма квадратов оконных сумм
+        uint64_t mdevTerms = 0;
+    };
+
+    int64_t phaseAt(uint64_t index) const { return m_phase[index & (m_phase.size() - 1)]; }
+
+    uint64_t m_maxFactor;
+    double m_tau0 = 1.0;
+    uint64_t m_count = 0;
+    uint64_t m_segmentStart = 0;        // Номер первого значения текущего отрезка
+    int64_t m_origin = 0;               // Первое значение: фаза хранится относительно него
+    std::vector<int64_t> m_phase;       // Кольцо последних значений, 2^k >= 2·maxFactor + 1
+    std::vector<Octave> m_octaves;
+};
+
+// Приемник потока измерений: потоковая кривая стабильности каждой пары
+// (i > j). Итерации с ошибкой чтения пропускаются, на разрывах (см.
+// PHCGapDetector) непрерывность фазы прерывается.
+class PHCStabilitySink : public MeasurementSink {
+public:
+    explicit PHCStabilitySink(double tau0 = 1.0, uint64_t maxFactor = PHCStabilityAccumulator::DEFAULT_MAX_FACTOR)
+        : m_tau0(tau0), m_maxFactor(maxFactor) {}
+
+    void setTau0(double tau0) { m_tau0 = tau0; }
+    void reset(size_t numDevices);
+    void append(int64_t timestamp, const int64_t* offsets, bool valid);
+    void onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) override;
+    bool onSample(const PHCSampleView& sample) override;
+
+    size_t numDevices() const { return m_numDevices; }
+    uint64_t gaps() const { return m_gaps.gaps(); }
+    // Кривая пары i > j
+    void curve(size_t i, size_t j, std::vector<PHCStabilityPoint>& out) const;
+
+private:
+    double m_tau0;
+    uint64_t m_maxFactor;
+    size_t m_numDevices = 0;
+    PHCGapDetector m_gaps;
+    std::vector<PHCStabilityAccumulator> m_pairs;   // По i * (i - 1) / 2 + j
+};
+
+// Точка кривой MTIE для интервала наблюдения τ = factor·τ0: наибольший
+// размах ошибки времени (TIE - фаза пары относительно первого значения)
+// среди всех окон из factor + 1 соседних значений
+struct PHCMtiePoint {
+    uint64_t factor = 0;        // Интервал наблюдения в шагах τ0
+    double tau = 0.0;           // Интервал наблюдения (с)
+    int64_t mtie = 0;           // MTIE (нс)
+    uint64_t windows = 0;       // Окон в оценке (N - factor)
+    double limit = 0.0;         // Предел маски (нс), 0 - τ вне маски
+    bool pass = true;           // mtie не превышает предел
+};
+
+// Маска MTIE в духе G.8271/G.8272: точки (τ, предел) по неубыванию τ,
+// между точками предел меняется линейно, после последней - постоянен, до
+// первой интервалы не проверяются. Две точки с одним τ задают скачок.
+class PHCMtieMask {
+public:
+    // SPEC - "TAU:NS,TAU:NS,..." (τ в секундах, предел в наносекундах)
+    bool parse(const std::string& spec, std::string& error);
+    bool empty() const { return m_points.empty(); }
+    // Предел при τ; 0, если τ меньше первой точки
+    double limit(double tau) const;
+    // Заполнить limit и pass точек кривой; true, если пройдены все
+    bool apply(std::vector<PHCMtiePoint>& curve) const;
+
+private:
+    std::vector<std::pair<double, double>> m_points;
+};
+
+// MTIE по фазовым данным x[0..N) с шагом τ0 для октавных интервалов
+// τ = m·τ0, m = 1, 2, 4, ... (пока m < N), или по отрезкам без разрывов
+// (окно не пересекает разрыв, иначе оно охватывало бы больше τ):
+//
+//   MTIE(τ) = max_k (max x[k..k+m] - min x[k..k+m])
+//
+// Минимум и максимум скользящего окна ведутся монотонными очередями, поэтому
+// каждый интервал стоит O(N) вместо O(N·m). Интервалы независимы и
+// считаются параллельно.
+class PHCMtie {
+public:
+    // tau0 - шаг фазовых данных (нс); maxFactor - наибольший m (0 - без
+    // ограничения); threads - число потоков (0 - по числу CPU)
+    static void compute(const int64_t* phase, size_t n, double tau0, std::vector<PHCMtiePoint>& out,
+                        uint64_t maxFactor = 0, unsigned threads = 0);
+    static void compute(const std::vector<int64_t>& phase, double tau0, std::vector<PHCMtiePoint>& out,
+                        uint64_t maxFactor = 0, unsigned threads = 0) {
+        compute(phase.data(), phase.size(), tau0, out, maxFactor, threads);
+    }
+    static void compute(const PHCPhaseSegments& segments, double tau0, std::vector<PHCMtiePoint>& out,
+                        uint64_t maxFactor = 0, unsigned threads = 0);
+};
+
+// Потоковый расчет MTIE: каждое значение продвигает окна всех октавных
+// интервалов до maxFactor, амортизированно O(1) на интервал. Хранятся
+// последние maxFactor + 2 значения фазы и монотонные очереди индексов.
+class PHCMtieAccumulator {
+public:
+    static constexpr uint64_t DEFAULT_MAX_FACTOR = uint64_t(1) << 14;
+
+    explicit PHCMtieAccumulator(uint64_t maxFactor = DEFAULT_MAX_FACTOR);
+
+    // Очистить; tau0 - шаг фазовых данных (нс)
+    void reset(double tau0);
+    void add(int64_t phase);
+    // Разрыв: следующие окна не захватывают фазу до него
+    void gap();
+    uint64_t count() const { return m_count; }
+    void curve(std::vector<PHCMtiePoint>& out) const;
+
+private:
+    struct Interval {
+        uint64_t factor;
+        std::deque<uint64_t> minimum;   // Индексы с возрастающей фазой
+        std::deque<uint64_t> maximum;   // Индексы с убывающей фазой
+        int64_t mtie = 0;
+        uint64_t windows = 0;
+    };
+
+    int64_t phaseAt(uint64_t index) const { return m_phase[index & (m_phase.size() - 1)]; }
+
+    uint64_t m_maxFactor;
+    double m_tau0 = 1.0;
+    uint64_t m_count = 0;
+    uint64_t m_segmentStart = 0;        // Номер первого значения текущего отрезка
+    std::vector<int64_t> m_phase;       // Кольцо последних значений, 2^k >= maxFactor + 2
+    std::vector<Interval> m_intervals;
+};
+
+// Приемник потока измерений: потоковая кривая MTIE каждой пары (i > j).
+// Итерации с ошибкой чтения пропускаются, окна не пересекают разрывы.
+class PHCMtieSink : public MeasurementSink {
+public:
+    explicit PHCMtieSink(double tau0 = 1.0, uint64_t maxFactor = PHCMtieAccumulator::DEFAULT_MAX_FACTOR)
+        : m_tau0(tau0), m_maxFactor(maxFactor) {}
+
+    void setTau0(double tau0) { m_tau0 = tau0; }
+    void reset(size_t numDevices);
+    void append(int64_t timestamp, const int64_t* offsets, bool valid);
+    void onStart(const std::vector<int>& devices, const std::vector<PHCReadMethod>& methods) override;
+    bool onSample(const PHCSampleView& sample) override;
+
+    size_t numDevices() const { return m_numDevices; }
+    uint64_t gaps() const { return m_gaps.gaps(); }
+    // Кривая пары i > j
+    void curve(size_t i, size_t j, std::vector<PHCMtiePoint>& out) const;
+
+private:
+    double m_tau0;
+    uint64_t m_maxFactor;
+    size_t m_numDevices = 0;
+    PHCGapDetector m_gaps;
+    std::vector<PHCMtieAccumulator> m_pairs;        // По i * (i - 1) / 2 + j
+};
+
+#endif // DIFFPHC_STABILITY_H
@@ -0,0 +1,174 @@
+// Проверка отсутствия обращений к куче в цикле измерения: malloc и
+// семейство (через них и operator new) подменяются счетчиком, сессия на
+// моделях PHC прогоняется в разных режимах, и число выделений памяти
+// после прогрева не должно расти от итерации к итерации.
+
+#include "diffphc_core.h"
+#include "diffphc_clock_source.h"
+#include <cerrno>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+// Итерации до снимка счетчика: за это время заполняются кольца,
+// буферы t-digest и прочие структуры, растущие до постоянного размера
+constexpr int WarmupIterations = 2000;
+constexpr int Iterations = 6000;
+
+// Приемник, снимающий счетчик выделений на границах устойчивого режима
+class AllocationProbe : public MeasurementSink {
+public:
+    bool onSample(const PHCSampleView& sample) override {
+        if (sample.sequence == WarmupIterations) {
+            m_warm = allocations.load();
+        }
+        m_last = allocations.load();
+        return true;
+    }
+    uint64_t steadyAllocations() const { return m_last - m_warm; }
+
+private:
+    uint64_t m_warm = 0;
+    uint64_t m_last = 0;
+};
+
+bool check(const char* name, PHCConfig config) {
+    config.count = Iterations;
+    config.delay = 1;
+    config.simulate = true;
+    config.devices = {0, 1, 2};
+
+    PHCSession session;
+    std::string error;
+    if (!session.open(config, error)) {
+        std::fprintf(stderr, "%s: %s\n", name, error.c_str());
+        return false;
+    }
+    AllocationProbe probe;
+    PHCResult result = session.run(probe);
+    if (!result.success) {
+        std::fprintf(stderr, "%s: %s\n", name, result.error.c_str());
+        return false;
+    }
+
+    uint64_t steady = probe.steadyAllocations();
+    std::printf("%-12s %llu allocations in %d steady-state iterations\n",
+                name, (unsigned long long)steady, Iterations - WarmupIterations - 1);
+    return steady == 0;
+}
+
+// sampleLatest() с одним PHCResult на весь прогон, как в таймере GUI
+bool checkLatest(PHCConfig config) {
+    config.simulate = true;
+    config.devices = {0, 1, 2};
+
+    PHCSession session;
+    std::string error;
+    if (!session.open(config, error)) {
+        std::fprintf(stderr, "latest: %s\n", error.c_str());
+        return false;
+    }
+    PHCResult result;
+    uint64_t warm = 0;
+    for (int i = 0; i < Iterations; ++i) {
+        if (i == WarmupIterations) {
+            warm = allocations.load();
+        }
+        session.sampleLatest(result);
+    }
+    uint64_t steady = allocations.load() - warm;
+    std::printf("%-12s %llu allocations in %d steady-state iterations\n",
+                "latest", (unsigned long long)steady, Iterations - WarmupIterations);
+    return steady == 0;
+}
+
+// Буферизующий run(): все строки выделяются до первого чтения, поэтому
+// число выделений не зависит от числа итераций
+uint64_t bufferedAllocations(PHCConfig config, int iterations) {
+    config.count = iterations;
+    config.delay = 1;
+    config.simulate = true;
+    config.devices = {0, 1, 2};
+
+    PHCSession session;
+    std::string error;
+    if (!session.open(config, error)) {
+        std::fprintf(stderr, "buffered: %s\n", error.c_str());
+        return UINT64_MAX;
+    }
+    const uint64_t before = allocations.load();
+    PHCResult result = session.run();
+    const uint64_t after = allocations.load();
+    return result.success ? after - before : UINT64_MAX;
+}
+
+bool checkBuffered(const PHCConfig& config) {
+    const uint64_t shortRun = bufferedAllocations(config, Iterations - WarmupIterations);
+    const uint64_t longRun = bufferedAllocations(config, Iterations);
+    std::printf("%-12s %llu allocations for %d iterations, %llu for %d\n", "buffered",
+                (unsigned long long)shortRun, Iterations - WarmupIterations,
+                (unsigned long long)longRun, Iterations);
+    return shortRun != UINT64_MAX && shortRun == longRun;
+}
+
+} // namespace
+
+extern "C" {
+void* malloc(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+}
+
+int main() {
+    bool ok = true;
+
+    PHCConfig config;
+    config.simulation.outlierRate = 0.05;
+    ok = check("sequential", config) && ok;
+
+    PHCConfig parallel = config;
+    parallel.parallel = true;
+    ok = check("parallel", parallel) && ok;
+
+    PHCConfig adaptive = config;
+    adaptive.adaptiveSamples = true;
+    ok = check("adaptive", adaptive) && ok;
+
+    ok = checkLatest(config) && ok;
+    ok = checkBuffered(config) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -3,6 +3,7 @@
 #include <QDebug>
 #include <QTextStream>
 #include <QRegularExpression>
+#include <algorithm>
 
 WebServerAlternative::WebServerAlternative(QObject *parent)
     : QObject(parent)
@@ -83,6 +84,16 @@ void WebServerAlternative::addMeasurementResult(const PHCResult& result)
     QMutexLocker locker(&m_dataMutex);
     m_measurementHistory.push_back(result);
     
+    // Скользящие окна обновляются здесь, /api/status только читает их
+    if (result.success && !result.series.empty()) {
+        if (m_windowDevices != result.devices) {
+            m_windowDevices = result.devices;
+            m_windows.reset(result.series.numDevices());
+        }
+        const size_t last = result.series.size() - 1;
+        m_windows.append(result.series.timestamp(last), result.series.pairs(last), result.series.valid(last));
+    }
+    
     // Keep only last 1000 measurements to prevent memory issues
     if (m_measurementHistory.size() > 1000) {
         m_measurementHistory.erase(m_measurementHistory.begin(), m_measurementHistory.begin() + 100);
@@ -260,8 +271,8 @@ QJsonObject WebServerAlternative::getCurrentStatus()
         double sum = 0.0;
         int count = 0;
         for (const auto& result : m_measurementHistory) {
-            if (result.success && !result.differences.empty() && !result.differences[0].empty()) {
-                sum += static_cast<double>(result.differences[0][0]); // Use first difference as example
+            if (result.success && !result.series.empty() && result.series.numDevices() >= 2) {
+                sum += static_cast<double>(result.pairs(0)(1, 0)); // Разность первой пары устройств
                 count++;
             }
         }
@@ -271,6 +282,26 @@ QJsonObject WebServerAlternative::getCurrentStatus()
     }
     status["avgDifference"] = avgDiff;
     
+    QJsonArray windows;
+    const size_t numDev = std::min(m_windowDevices.size(), m_windows.numDevices());
+    for (size_t i = 1; i < numDev; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            for (size_t w = 0; w < m_windows.windowCount(); ++w) {
+                const PHCRunningStats stats = m_windows.statistics(w, i, j);
+                QJsonObject item;
+                item["pair"] = QString("ptp%1-ptp%2").arg(m_windowDevices[i]).arg(m_windowDevices[j]);
+                item["widthSeconds"] = static_cast<double>(m_windows.width(w) / 1000000000LL);
+                item["count"] = static_cast<double>(stats.count);
+                item["mean"] = stats.mean;
+                item["minimum"] = static_cast<double>(stats.minimum);
+                item["maximum"] = static_cast<double>(stats.maximum);
+                item["stddev"] = stats.stddev();
+                windows.append(item);
+            }
+        }
+    }
+    status["windows"] = windows;
+    
     return status;
 }
 
@@ -282,8 +313,8 @@ QJsonArray WebServerAlternative::getMeasurementHistory()
     for (const auto& result : m_measurementHistory) {
         QJsonObject item;
         item["timestamp"] = QDateTime::fromMSecsSinceEpoch(result.baseTimestamp / 1000000).toString(Qt::ISODate);
-        if (!result.differences.empty() && !result.differences[0].empty()) {
-            item["difference"] = static_cast<double>(result.differences[0][0]);
+        if (!result.series.empty() && result.series.numDevices() >= 2) {
+            item["difference"] = static_cast<double>(result.pairs(0)(1, 0));
         } else {
             item["difference"] = 0.0;
         }
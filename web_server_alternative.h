@@ -16,6 +16,7 @@
 #include <QMap>
 #include <vector>
 #include "diffphc_core.h"
+#include "diffphc_rollup.h"
 
 class WebServerAlternative : public QObject
 {
@@ -68,6 +69,8 @@ private:
     
     // Data storage
     std::vector<PHCResult> m_measurementHistory;
+    PHCSlidingStats m_windows;          // Окна 1 с / 1 мин / 1 ч для /api/status
+    std::vector<int> m_windowDevices;
     PHCConfig m_currentConfig;
     std::vector<int> m_availableDevices;
     bool m_measuring;
@@ -184,8 +184,8 @@ QJsonObject WebServerMinimal::getCurrentStatus()
         double sum = 0.0;
         int count = 0;
         for (const auto& result : m_measurementHistory) {
-            if (result.success && !result.differences.empty() && !result.differences[0].empty()) {
-                sum += static_cast<double>(result.differences[0][0]); // Use first difference as example
+            if (result.success && !result.series.empty() && result.series.numDevices() >= 2) {
+                sum += static_cast<double>(result.pairs(0)(1, 0)); // Разность первой пары устройств
                 count++;
             }
         }
@@ -206,8 +206,8 @@ QJsonArray WebServerMinimal::getMeasurementHistory()
     for (const auto& result : m_measurementHistory) {
         QJsonObject item;
         item["timestamp"] = QDateTime::fromMSecsSinceEpoch(result.baseTimestamp / 1000000).toString(Qt::ISODate);
-        if (!result.differences.empty() && !result.differences[0].empty()) {
-            item["difference"] = static_cast<double>(result.differences[0][0]);
+        if (!result.series.empty() && result.series.numDevices() >= 2) {
+            item["difference"] = static_cast<double>(result.pairs(0)(1, 0));
         } else {
             item["difference"] = 0.0;
         }
@@ -392,8 +392,8 @@ QJsonObject WebServerSimple::getCurrentStatus()
         double sum = 0.0;
         int count = 0;
         for (const auto& result : m_measurementHistory) {
-            if (result.success && !result.differences.empty() && !result.differences[0].empty()) {
-                sum += result.differences[0][0]; // Use first difference as example
+            if (result.success && !result.series.empty() && result.series.numDevices() >= 2) {
+                sum += result.pairs(0)(1, 0); // Разность первой пары устройств
                 count++;
             }
         }
@@ -414,8 +414,8 @@ QJsonArray WebServerSimple::getMeasurementHistory()
     for (const auto& result : m_measurementHistory) {
         QJsonObject item;
         item["timestamp"] = QDateTime::fromMSecsSinceEpoch(result.baseTimestamp / 1000000).toString(Qt::ISODate);
-        if (!result.differences.empty() && !result.differences[0].empty()) {
-            item["difference"] = result.differences[0][0];
+        if (!result.series.empty() && result.series.numDevices() >= 2) {
+            item["difference"] = static_cast<double>(result.pairs(0)(1, 0));
         } else {
             item["difference"] = 0;
         }